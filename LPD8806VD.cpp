@@ -113,54 +113,120 @@ a 'latch' anyway.
   Tested.  Confirmed.  Fact.
 */
 
-#include <SPI.h>
+#if !defined(WIRING) && !defined(ARDUINO)
+ // Host build: no SPI library
+#else
+ #include <SPI.h>
+#endif
 #include "LPD8806VD.h"
 
+#if defined(LPD8806VD_ASYNC) && defined(LPD8806VD_AVR_SPI)
+ #define LPD8806VD_ASYNC_SPI
+#endif
+
+#if defined(LPD8806VD_STATS)
+ #if defined(LPD8806VD_HOST)
+  #include <chrono>
+  static uint32_t micros(void)
+  {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+ #endif
+ #define LPD8806VD_STAT(x) x
+#else
+ #define LPD8806VD_STAT(x)
+#endif
+
+// Pixels encoded per pass when streaming without a wire buffer.
+// Costs 3 bytes of stack per pixel (6 with showStream()).
+#define LPD8806VD_CHUNK 16
+
 /*****************************************************************************/
 
 // Constructor for use with hardware SPI.
 // Pixel buffer NOT set.
-LPD8806VD::LPD8806VD(uint16_t n, uint8_t depth)
+LPD8806VD::LPD8806VD(LPD8806VDIndex n, uint8_t depth)
 {
-  LPD8806VD(n, (uint8_t *)NULL, depth);
+  init(n, (uint8_t *)NULL, depth);
+  updatePins();
 }
 
 // Constructor for use with hardware SPI.
-LPD8806VD::LPD8806VD(uint16_t n, uint8_t *buf, uint8_t depth)
+LPD8806VD::LPD8806VD(LPD8806VDIndex n, uint8_t *buf, uint8_t depth)
 {
-  pixels = buf;
-  begun  = false;
-  setColorDepth(depth);
-  updateLength(n);
+  init(n, buf, depth);
   updatePins();
 }
 
 
 // Constructor for use with arbitrary clock/data pins:
 // Pixel buffer NOT set.
-LPD8806VD::LPD8806VD(uint16_t n, uint8_t dpin, uint8_t cpin, uint8_t depth)
+LPD8806VD::LPD8806VD(LPD8806VDIndex n, uint8_t dpin, uint8_t cpin, uint8_t depth)
 {
-  LPD8806VD(n, dpin, cpin, (uint8_t *)NULL, depth);
+  init(n, (uint8_t *)NULL, depth);
+  updatePins(dpin, cpin);
 }
 
 
 // Constructor for use with arbitrary clock/data pins:
-LPD8806VD::LPD8806VD(uint16_t n, uint8_t dpin, uint8_t cpin, uint8_t *buf, uint8_t depth)
+LPD8806VD::LPD8806VD(LPD8806VDIndex n, uint8_t dpin, uint8_t cpin, uint8_t *buf, uint8_t depth)
 {
-  pixels = buf;
-  begun  = false;
+  init(n, buf, depth);
+  updatePins(dpin, cpin);
+}
+
+
+// Constructor for use with any transport.
+LPD8806VD::LPD8806VD(LPD8806VDIndex n, LPD8806VDTransport *t, uint8_t *buf, uint8_t depth)
+{
+  init(n, buf, depth);
+  setTransport(t);
+}
+
+
+// Common constructor setup.
+// (Constructors can't call each other here -- that only builds a temporary.)
+void LPD8806VD::init(LPD8806VDIndex n, uint8_t *buf, uint8_t depth)
+{
+  pixels      = buf;
+  wire        = NULL;
+  palette     = NULL;
+  paletteBits = 0;
+  levels      = NULL;
+  brightness  = 255;
+  gamma       = false;
+  dither      = LPD8806VD_DITHER_OFF;
+  ditherFrame = 0;
+  ditherErr   = NULL;
+  wireStale   = false;
+  dirtyEnd    = 0;
+  sending     = false;
+  asyncLeft   = 0;
+  begun       = false;
+  hardwareSPI = false;
+  transport   = NULL;
+  LPD8806VD_STAT(resetStats());
   setColorDepth(depth);
   updateLength(n);
-  updatePins(dpin, cpin);
 }
 
 
 // Sets the color depth.
 // Accepted color depths: 1, 2, 3 (or 8, 15/16, 21/24)
+// Also switches back to direct color from indexed color.
+// Depth 4 is 4 bit indexed color, (numPixels() + 1) / 2 buffer bytes;
+// give it a palette with setPalette(pal, 4) before showing.
 void LPD8806VD::setColorDepth(uint8_t depth)
 {
+  paletteBits = 0;
+
   switch (depth)
   {
+    case 4:
+      paletteBits = 4;
+      colorDepth  = 1;
+      break;
     case 1:
     case 2:
     case 3:
@@ -184,14 +250,11 @@ void LPD8806VD::setColorDepth(uint8_t depth)
 }
 
 
-// Activate hard/soft SPI as appropriate.
+// Activate the transport (hard/soft SPI, etc.) and issue initial latch.
 void LPD8806VD::begin(void)
 {
-  if (hardwareSPI == true)
-    startSPI();
-  else
-    startBitbang();
   begun = true;
+  useTransport(transport);
 }
 
 
@@ -199,11 +262,11 @@ void LPD8806VD::begin(void)
 void LPD8806VD::updatePins(void)
 {
   hardwareSPI = true;
-  datapin     = clkpin = 0;
-  // If begin() was previously invoked, init the SPI hardware now:
-  if (begun == true)
-    startSPI();
-  // Otherwise, SPI is NOT initted until begin() is explicitly called.
+#if !defined(LPD8806VD_HOST)
+  useTransport(&spi);
+#else
+  useTransport(NULL);
+#endif
 
   // Note: any prior clock/data pin directions are left as-is and are
   // NOT restored as inputs!
@@ -213,262 +276,597 @@ void LPD8806VD::updatePins(void)
 // Change pin assignments post-constructor, using arbitrary pins.
 void LPD8806VD::updatePins(uint8_t dpin, uint8_t cpin)
 {
-  datapin     = dpin;
-  clkpin      = cpin;
-  clkport     = dataport = 0;
-  clkpinmask  = datapinmask = 0;
-
-#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__) || defined (__AVR_ATmega328__) || defined(__AVR_ATmega8__) || (__AVR_ATmega1281__) || defined(__AVR_ATmega2561__) || defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
-  clkport     = portOutputRegister(digitalPinToPort(cpin));
-  clkpinmask  = digitalPinToBitMask(cpin);
-  dataport    = portOutputRegister(digitalPinToPort(dpin));
-  datapinmask = digitalPinToBitMask(dpin);
+  hardwareSPI = false;
+#if !defined(LPD8806VD_HOST)
+  bitbang.setPins(dpin, cpin);
+  useTransport(&bitbang);
+#else
+  (void)dpin;
+  (void)cpin;
+  useTransport(NULL);
 #endif
 
-  if (begun == true)  // If begin() was previously invoked...
-  {
-    // If previously using hardware SPI, turn that off:
-    if (hardwareSPI == true)
-      SPI.end();
-    startBitbang(); // Regardless, now enable 'soft' SPI outputs
-  } // Otherwise, pins are not set to outputs until begin() is called.
-
   // Note: any prior clock/data pin directions are left as-is and are
   // NOT restored as inputs!
+}
 
+
+// Change to any transport post-constructor.
+void LPD8806VD::setTransport(LPD8806VDTransport *t)
+{
   hardwareSPI = false;
+  useTransport(t);
 }
 
 
-// Enable SPI hardware and set up protocol details.
-// TODO: Hardware SPI - remove #if defined's
-void LPD8806VD::startSPI(void)
+// Set the transport's bit rate, in Hz (hardware SPI: rounded down to
+// what the hardware can do; 0 for the default SPI_CLOCK_DIV4).
+// Returns the rate set, or 0 if the transport has no rate control.
+uint32_t LPD8806VD::setClock(uint32_t hz)
 {
-  uint8_t i = latchBytes;
+  if (transport == NULL)
+    return 0;
 
-  SPI.begin();
-  SPI.setBitOrder(MSBFIRST);
-  SPI.setDataMode(SPI_MODE0);
+  waitShow();
+  return transport->setClock(hz);
+}
 
-  // Go as fast as you can go!!! :)
-  // 16MHz / 2 = 8 MHz -- go like sn*t!
 
-  SPI.setClockDivider(SPI_CLOCK_DIV4);
+// Step the bit rate up from 500kHz to maxHz, checking each rate with the
+// transport's read back (hardware SPI: jumper MISO to MOSI), and keep the
+// fastest rate that works.  Returns that rate, or 0 if none worked (the
+// rate is then unchanged).  Call after begin(); the strip is shown again
+// afterwards, as the test pattern goes out to it too.
+uint32_t LPD8806VD::calibrateClock(uint32_t maxHz)
+{
+  uint32_t rate;
 
-  // Although the LPD8806 should, in theory, work up to 20MHz, the unshielded
-  // wiring from the microcontroller can be more susceptible to interference.
-  // Experiment and see what you get.
+  if (transport == NULL)
+    return 0;
 
-  if (latchBytes == 0) return;
-  
-  // Issue initial latch/reset to strip:
+  waitShow();
+  rate = transport->calibrate(500000UL, maxHz);
+  show();
+  return rate;
+}
 
-#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__) || defined (__AVR_ATmega328__) || defined(__AVR_ATmega8__) || (__AVR_ATmega1281__) || defined(__AVR_ATmega2561__) || defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
 
-  while (i--)
-  {
-    SPDR = 0;
-    while (!(SPSR & (1 << SPIF))); // Wait for prior byte out
-  }
-#else
-  while (i--)
+// Switch transports.
+// If begin() was previously invoked, the new transport is started and
+// the strip latched now.  Otherwise, the transport is NOT started until
+// begin() is explicitly called.
+void LPD8806VD::useTransport(LPD8806VDTransport *t)
+{
+  if (begun == true)
   {
-    SPI.transfer(0);
+    waitShow();
+    if (transport != NULL && transport != t)
+      transport->end();  // e.g. turn off hardware SPI
+    if (t != NULL)
+    {
+      t->begin();
+    }
   }
-#endif
+
+  transport = t;
+  if (begun == true)
+    sendZeros(latchBytes);
 }
 
 
-// Send off a byte via bit bang.
-// TODO: use shiftOut()
-void LPD8806VD::sendBitBangByte(uint8_t data)
+// Update the length of the strip.
+void LPD8806VD::updateLength(LPD8806VDIndex n)
+{
+  waitShow();
+
+  latchBytes = (n + 31) / 32;  // 1 latch byte every 32 "pixels"
+
+  numLEDs    = n;
+
+  clear();
+
+  // 'begun' state does not change -- pins retain prior modes
+}
+
+// Clear the pixel array.
+void LPD8806VD::clear(void)
 {
-  // MSBFIRST implied
-  uint8_t bit;
+  if (pixels != NULL)
+  {
+    memset(pixels, 0, bufferSize());          // Clear the array
+  }
 
-  for (bit = 0x80; bit; bit >>= 1)
+  dirtyEnd = numLEDs;
+
+  if (wire != NULL)
   {
-    // use low level bitbanging when we can
-    if (dataport != 0)
+    if (sending)
     {
-      if (data & bit)
-        *dataport |=  datapinmask;
-      else
-        *dataport &= ~datapinmask;
-      *clkport |=  clkpinmask;
-      *clkport &= ~clkpinmask;
+      wireStale = true;                           // Re-encode at next show
     }
     else
     {
-      // can't do low level bitbanging, revert to digitalWrite
-      if (data & bit)
-        digitalWrite(datapin, HIGH);
-      else
-        digitalWrite(datapin, LOW);
-      digitalWrite(clkpin, HIGH);
-      digitalWrite(clkpin, LOW);
+      memset(wire, 0x80, numLEDs * 3);            // "Black" on the wire
+      memset(wire + numLEDs * 3, 0, latchBytes);  // Latch bytes
     }
   }
 }
 
 
-// Enable software SPI pins and issue initial latch.
-void LPD8806VD::startBitbang()
+// Set the pixel buffer.
+// Safe to call during a background show: the wire buffer is the "front"
+// buffer being sent, the pixel buffer is the "back" buffer being drawn.
+// The wire buffer is re-encoded from the new buffer at the next show.
+void LPD8806VD::setBufferPointer(uint8_t *buf)
 {
-  uint8_t i = latchBytes;
+  pixels    = buf;
+  wireStale = true;
+  dirtyEnd  = numLEDs;
+}
 
-  pinMode(datapin, OUTPUT);
-  pinMode(clkpin , OUTPUT);
-  
-  if (latchBytes == 0) return;
 
-  // send a "latch" clear
-  while (i--)
-  {
-    sendBitBangByte(0);
-  }
+// Mark pixels 0..n-1 as changed, e.g. after writing to the pixel buffer
+// directly (also call encode() if using a wire buffer).
+void LPD8806VD::setDirty(LPD8806VDIndex n)
+{
+  if (n > numLEDs)
+    n = numLEDs;
+  if (n > dirtyEnd)
+    dirtyEnd = n;
 }
 
 
-// Update the length of the strip.
-void LPD8806VD::updateLength(uint16_t n)
+// Set a wire-ready transmit buffer, LPD8806VD_WIRE_SIZE(numPixels()) bytes.
+// When set, the buffer holds the exact byte stream for the strip (GRB
+// components with the high bit set, followed by the latch bytes) and is
+// kept up to date by setPixelColor() and clear(), so show() only has to
+// stream it out.  Costs 3 bytes per pixel, on top of the pixel buffer.
+// If you write to the pixel buffer directly, call encode() afterwards.
+void LPD8806VD::setWireBuffer(uint8_t *buf)
 {
-  latchBytes = (n + 31) / 32;  // 1 latch byte every 32 "pixels"
+  waitShow();
+  wire = buf;
+  encode();
+}
 
-  numLEDs    = n;
 
-  clear();
+// Re-encode the whole pixel buffer into the wire buffer.
+void LPD8806VD::encode(void)
+{
+  if (wire == NULL)
+    return;
 
-  // 'begun' state does not change -- pins retain prior modes
+  waitShow();
+  wireStale = false;
+  LPD8806VD_STAT(uint32_t t = micros());
+
+  if (pixels != NULL)
+    encodePixels(0, numLEDs, wire);
+  else
+    memset(wire, 0x80, numLEDs * 3);
+
+  LPD8806VD_STAT(stats.encodeMicros += micros() - t);
+
+  memset(wire + numLEDs * 3, 0, latchBytes);
 }
 
-// Clear the pixel array.
-void LPD8806VD::clear(void)
+
+// Encode count pixels, starting at pixel first, into wire format
+// (3 bytes per pixel, GRB, high bit set).
+// Not timed here: setPixelColor() calls this for every pixel with a
+// wire buffer, so the callers that encode at show time do the timing.
+void LPD8806VD::encodePixels(LPD8806VDIndex first, LPD8806VDIndex count, uint8_t *out)
 {
-  if (pixels != NULL)
-  {
-    memset(pixels, 0, numLEDs * colorDepth);  // Clear the array
-  }
+  if (paletteBits == 4)
+    encodeRun(&pixels[first >> 1], first & 1, count, out);
+  else
+    encodeRun(&pixels[first * colorDepth], 0, count, out);
+  applyLevels(out, count * 3);
 }
 
 
-// This is how data is pushed to the strip.  Unfortunately, the company
-// that makes the chip didnt release the protocol document or you need
-// to sign an NDA or something stupid like that, but we reverse engineered
-// this from a strip controller and it seems to work very nicely!
-void LPD8806VD::show(void)
+// Encode count packed pixels from ptr into wire format (before the
+// output stage).  With 4 bit indexes, odd = 1 starts at the low nibble
+// of *ptr.
+// One pass per color depth -- no per-pixel switching (and SIMD, where
+// the target has it; see LPD8806VDCodec.h).
+void LPD8806VD::encodeRun(const uint8_t *ptr, uint8_t odd, LPD8806VDIndex count, uint8_t *out)
 {
-  uint8_t  *ptr = pixels;
-  uint16_t i    = numLEDs;
-  uint8_t  r, g, b;
-  uint16_t color;
+  const uint8_t *e;
+
+  if (paletteBits != 0 && palette == NULL)
+  {
+    memset(out, 0x80, count * 3);           // No palette yet: black
+    return;
+  }
 
-  while (i--)
+  if (paletteBits == 8)
+  {
+    for (; count; count--, ptr++, out += 3)
+    {
+      e = &palette[*ptr * 3];
+      out[0] = e[0] | 0x80;
+      out[1] = e[1] | 0x80;
+      out[2] = e[2] | 0x80;
+    }
+  }
+  else if (paletteBits == 4)
+  {
+    for (; count; count--, odd ^= 1, out += 3)
+    {
+      e = &palette[(odd ? (*ptr++ & 0x0f) : (*ptr >> 4)) * 3];
+      out[0] = e[0] | 0x80;
+      out[1] = e[1] | 0x80;
+      out[2] = e[2] | 0x80;
+    }
+  }
+  else
   {
     switch (colorDepth)
     {
       case 1:
-        g = getGreen8(*ptr);
-        r = getRed8(*ptr);
-        b = getBlue8(*ptr);
+        LPD8806VDCodec<1>::encodeBulk(ptr, out, count);
         break;
       case 2:
-        color = ((uint16_t)(*ptr) << 8) | (uint16_t)(*(ptr + 1));
-        g = getGreen16(color);
-        r = getRed16(color);
-        b = getBlue16(color);
+        LPD8806VDCodec<2>::encodeBulk(ptr, out, count);
         break;
       case 3:
-        g = *ptr;
-        r = *(ptr + 1);
-        b = *(ptr + 2);
+        LPD8806VDCodec<3>::encodeBulk(ptr, out, count);
         break;
     }
+  }
+
+}
 
-    // We need to set the upper bit on all components
-    g |= 0x80;
-    r |= 0x80;
-    b |= 0x80;
 
-    if (hardwareSPI)
+// Output stage: brightness/gamma, on len wire bytes.
+void LPD8806VD::applyLevels(uint8_t *out, LPD8806VDIndex len)
+{
+  if (levels != NULL)
+  {
+    for (; len; len--, out++)
+      *out = levels[*out & 0x7f] | 0x80;
+  }
+}
+
+
+// This is how data is pushed to the strip.  Unfortunately, the company
+// that makes the chip didnt release the protocol document or you need
+// to sign an NDA or something stupid like that, but we reverse engineered
+// this from a strip controller and it seems to work very nicely!
+void LPD8806VD::show(void)
+{
+  waitShow();
+  sendPixels(numLEDs);
+
+  // Now send "latch" clear bytes (0)
+  sendZeros(latchBytes);
+  dirtyEnd = 0;
+  LPD8806VD_STAT(statsFrame());
+}
+
+
+// Show pixels that are not in the pixel buffer: fill(first, count, buf,
+// ctx) is called for each chunk of pixels along the strip and puts count
+// packed pixels (as they would be in the pixel buffer) in buf, which are
+// encoded and sent straight away.  So the strip can be far longer than
+// RAM allows: pixels can come from external RAM, flash, or be computed.
+// No pixel buffer is needed; if there is one, it is left alone (and all
+// marked changed, as the strip no longer shows it).
+void LPD8806VD::showStream(LPD8806VDFill fill, void *ctx)
+{
+  uint8_t  src[LPD8806VD_CHUNK * 3];
+  uint8_t  buf[LPD8806VD_CHUNK * 3];
+  LPD8806VDIndex i, count;
+
+  waitShow();
+
+  for (i = 0; i < numLEDs; i += count)
+  {
+    count = numLEDs - i;
+    if (count > LPD8806VD_CHUNK)
+      count = LPD8806VD_CHUNK;
+    fill(i, count, src, ctx);
+    LPD8806VD_STAT(uint32_t t = micros());
+    encodeRun(src, 0, count, buf);
+    applyLevels(buf, count * 3);
+    LPD8806VD_STAT(stats.encodeMicros += micros() - t);
+    sendBytes(buf, count * 3);
+  }
+
+  // Now send "latch" clear bytes (0)
+  sendZeros(latchBytes);
+  if (pixels != NULL)
+    setDirty(numLEDs);
+  LPD8806VD_STAT(statsFrame());
+}
+
+
+// Show pixels computed as they are sent: shader(n, ctx) returns pixel n
+// as 7 bit GRB (as LPD8806VDCodec<3>::Color(r, g, b) makes it), which
+// then goes through the output stage (brightness/gamma) and out.
+// With mix above 0, each pixel is mixed with the stored one, from 0 (all
+// shader; the pixel buffer is not read) to 255 (all stored).
+// The pixel buffer is left alone (but all marked changed).
+void LPD8806VD::showShader(LPD8806VDShader shader, void *ctx, uint8_t mix)
+{
+  uint8_t  buf[LPD8806VD_CHUNK * 3];
+  uint8_t  stored[LPD8806VD_CHUNK * 3];
+  LPD8806VDIndex i, j, count;
+  uint16_t a = mix + (mix >> 7);              // 0..256
+  uint32_t c;
+  uint8_t  *out;
+
+  waitShow();
+  if (pixels == NULL)
+    a = 0;
+
+  for (i = 0; i < numLEDs; i += count)
+  {
+    count = numLEDs - i;
+    if (count > LPD8806VD_CHUNK)
+      count = LPD8806VD_CHUNK;
+
+    LPD8806VD_STAT(uint32_t t = micros());
+    for (j = 0, out = buf; j < count; j++, out += 3)
     {
-#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__) || defined (__AVR_ATmega328__) || defined(__AVR_ATmega8__) || (__AVR_ATmega1281__) || defined(__AVR_ATmega2561__) || defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
-      SPDR = g;              // Issue new byte
-      while (!(SPSR & (1 << SPIF))); // Wait for prior byte out
-      SPDR = r;              // Issue new byte
-      while (!(SPSR & (1 << SPIF))); // Wait for prior byte out
-      SPDR = b;              // Issue new byte
-      while (!(SPSR & (1 << SPIF))); // Wait for prior byte out
-#else
-      SPI.transfer(g);
-      SPI.transfer(r);
-      SPI.transfer(b);
-#endif
+      c = shader(i + j, ctx);
+      out[0] = (c >> 16) | 0x80;
+      out[1] = (c >> 8) | 0x80;
+      out[2] = c | 0x80;
     }
-    else
+
+    if (a != 0)
     {
-      sendBitBangByte(g);
-      sendBitBangByte(r);
-      sendBitBangByte(b);
+      if (paletteBits == 4)
+        encodeRun(&pixels[i >> 1], i & 1, count, stored);
+      else
+        encodeRun(&pixels[i * colorDepth], 0, count, stored);
+      for (j = 0; j < count * 3; j++)
+        buf[j] = (((buf[j] & 0x7f) * (256 - a) + (stored[j] & 0x7f) * a) >> 8) | 0x80;
     }
 
-    ptr += colorDepth;
+    applyLevels(buf, count * 3);
+    LPD8806VD_STAT(stats.encodeMicros += micros() - t);
+    sendBytes(buf, count * 3);
   }
 
-  
   // Now send "latch" clear bytes (0)
-  i = latchBytes;
-  while (i--)
+  sendZeros(latchBytes);
+  if (pixels != NULL)
+    setDirty(numLEDs);
+  LPD8806VD_STAT(statsFrame());
+}
+
+
+// Show only the pixels up to the last one changed since the last show.
+// Each LPD8806 latches its bytes as they pass through, so the rest of
+// the strip keeps its colors; the latch only has to reach the pixels
+// that were sent (1 latch byte every 32 pixels).  While dithering, the
+// whole strip changes every frame, so all of it is sent.
+void LPD8806VD::showDirty(void)
+{
+  LPD8806VDIndex end = (dither != LPD8806VD_DITHER_OFF) ? numLEDs : dirtyEnd;
+
+  if (end == 0)
+    return;
+
+  waitShow();
+  sendPixels(end);
+  sendZeros((end + 31) / 32);
+  dirtyEnd = 0;
+  LPD8806VD_STAT(statsFrame());
+}
+
+
+// Send pixels 0..end-1 (no latch).
+void LPD8806VD::sendPixels(LPD8806VDIndex end)
+{
+  uint8_t  buf[LPD8806VD_CHUNK * 3];
+  LPD8806VDIndex i = 0;
+  LPD8806VDIndex count;
+
+  // Dithering changes the output every frame.
+  if (dither != LPD8806VD_DITHER_OFF)
   {
-    if (hardwareSPI)
+    ditherFrame++;
+    while (i < end)
     {
-#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__) || defined (__AVR_ATmega328__) || defined(__AVR_ATmega8__) || (__AVR_ATmega1281__) || defined(__AVR_ATmega2561__) || defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
-      SPDR = 0;                      // send "latch" clear bytes (0)
-      while (!(SPSR & (1 << SPIF))); // Wait for prior byte out
+      count = end - i;
+      if (count > LPD8806VD_CHUNK)
+        count = LPD8806VD_CHUNK;
+      encodeDither(i, count, buf);
+      sendBytes(buf, count * 3);
+      i += count;
+    }
+    return;
+  }
+
+  // Wire-ready buffer: already encoded.
+  if (wire != NULL)
+  {
+    if (wireStale)
+      encode();
+    sendBytes(wire, end * 3);
+    return;
+  }
+
+  // Otherwise, encode a chunk of pixels at a time and send it off.
+  while (i < end)
+  {
+    count = end - i;
+    if (count > LPD8806VD_CHUNK)
+      count = LPD8806VD_CHUNK;
+    LPD8806VD_STAT(uint32_t t = micros());
+    encodePixels(i, count, buf);
+    LPD8806VD_STAT(stats.encodeMicros += micros() - t);
+    sendBytes(buf, count * 3);
+    i += count;
+  }
+}
+
+
+// Show all pixels, sending the wire buffer from the SPI interrupt, so
+// the next frame can be drawn into the pixel buffer in the meantime.
+// Needs a wire buffer, hardware SPI on AVR, and LPD8806VD_ASYNC enabled
+// in LPD8806VD.h -- otherwise this is the same as show().
+// Don't use the SPI bus for anything else until isBusy() is 'false'.
+// Note: the interrupt costs a fair part of each byte time at the fastest
+// SPI clocks, so this pays off most with longer strips and slower clocks.
+void LPD8806VD::showAsync(void)
+{
+#if defined(LPD8806VD_ASYNC_SPI)
+  if (wire == NULL || !hardwareSPI || numLEDs == 0)
+  {
+    show();
+    return;
+  }
+
+  waitShow();
+  if (dither != LPD8806VD_DITHER_OFF)
+  {
+    ditherFrame++;
+    encodeDither(0, numLEDs, wire);
+    wireStale = true;                       // Not the undithered pixels
+  }
+  else if (wireStale)
+    encode();
+
+  asyncStrip = this;
+  asyncPtr   = wire + 1;
+  asyncLeft  = numLEDs * 3 + latchBytes - 1;
+  dirtyEnd   = 0;
+  sending    = true;
+  LPD8806VD_STAT(stats.bytes += asyncLeft + 1);
+  LPD8806VD_STAT(statsFrame());
+
+  // A synchronous transfer leaves SPIF set: clear it (read SPSR, then
+  // SPDR) so the interrupt doesn't fire before the first byte is out.
+  (void)SPSR;
+  (void)SPDR;
+  SPDR  = *wire;                            // Issue first byte
+  SPCR |= (1 << SPIE);                      // Interrupt when each byte is out
 #else
-      SPI.transfer(0);
+  show();
 #endif
-    }
-    else
-    {
-      sendBitBangByte(0);
-    }
-    
+}
+
+
+// Wait for a background show to finish.
+void LPD8806VD::waitShow(void)
+{
+  while (sending);
+}
+
+
+LPD8806VD *LPD8806VD::asyncStrip = NULL;
+
+// Feed the next byte of a background show to the SPI hardware.
+void LPD8806VD::handleInterrupt(void)
+{
+#if defined(LPD8806VD_ASYNC_SPI)
+  LPD8806VD *strip = asyncStrip;
+
+  if (strip->asyncLeft)
+  {
+    SPDR = *strip->asyncPtr;                // Issue new byte
+    strip->asyncPtr++;
+    strip->asyncLeft--;
   }
+  else
+  {
+    SPCR &= ~(1 << SPIE);                   // All out, done
+    strip->sending = false;
+  }
+#endif
 }
 
+#if defined(LPD8806VD_ASYNC_SPI)
+ISR(SPI_STC_vect)
+{
+  LPD8806VD::handleInterrupt();
+}
+#endif
+
+
+// Send a run of bytes out to the strip.
+void LPD8806VD::sendBytes(const uint8_t *data, LPD8806VDIndex len)
+{
+  LPD8806VD_STAT(uint32_t t = micros());
+
+  if (transport != NULL)
+    transport->write(data, len);
+
+  LPD8806VD_STAT(stats.sendMicros += micros() - t);
+  LPD8806VD_STAT(stats.bytes += len);
+}
+
+
+// Send "latch" clear bytes (0).
+// These end a frame, so the transport is flushed too.
+void LPD8806VD::sendZeros(LPD8806VDIndex len)
+{
+  LPD8806VD_STAT(uint32_t t = micros());
+
+  if (transport != NULL)
+  {
+    transport->writeZeros(len);
+    transport->flush();
+  }
+
+  LPD8806VD_STAT(stats.sendMicros += micros() - t);
+  LPD8806VD_STAT(stats.bytes += len);
+}
+
+
+#if defined(LPD8806VD_STATS)
+void LPD8806VD::resetStats(void)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
+
+// A frame went out: count it, and start counting pixel writes for the next.
+void LPD8806VD::statsFrame(void)
+{
+  stats.frames++;
+  stats.framePixelWrites = stats.pixelWrites;
+  stats.pixelWrites      = 0;
+}
+#endif
+
 
 // The following set of methods get the LPD8806 GRB components.
 
 uint8_t LPD8806VD::getRed8(uint8_t c8)
 {
-  return ((c8 & 0b11100000) >> 1);
+  return LPD8806VDCodec<1>::red(c8);
 }
 
 uint8_t LPD8806VD::getGreen8(uint8_t c8)
 {
-  return ((c8 & 0b00011100) << 2);
+  return LPD8806VDCodec<1>::green(c8);
 }
 
 uint8_t LPD8806VD::getBlue8(uint8_t c8)
 {
-  return ((c8 & 0b00000011) << 5);
+  return LPD8806VDCodec<1>::blue(c8);
 }
 
 
 uint8_t LPD8806VD::getRed16(uint16_t c16)
 {
-  return ((c16 & 0b0111110000000000) >> (8 + 0));
+  return LPD8806VDCodec<2>::red(c16);
 }
 
 uint8_t LPD8806VD::getGreen16(uint16_t c16)
 {
-  return ((c16 & 0b0000001111100000) >> (2 + 1));
+  return LPD8806VDCodec<2>::green(c16);
 }
 
 uint8_t LPD8806VD::getBlue16(uint16_t c16)
 {
-  return ((c16 & 0b0000000000011111) << (3 - 1));
+  return LPD8806VDCodec<2>::blue(c16);
 }
 
 
@@ -548,111 +946,709 @@ uint32_t LPD8806VD::Color(uint8_t r, uint8_t g, uint8_t b)
   // C24 uses the direct color format for the LPD8806 (GRB)
   //     = 0ggggggg 0rrrrrrr 0bbbbbbb
   //     (the upper bit will be set later)
+  // With indexed color, this is the index of the closest palette entry.
+
+  if (paletteBits)
+    return closestPaletteIndex(r, g, b);
 
-  uint32_t packedColor = 0;
-  
   switch (colorDepth)
   {
     case 1:
-      packedColor = 0x000000ff &
-                    ((r & 0b11100000) |
-                     (g & 0b11100000) >> 3 |
-                     (b & 0b11000000) >> 6);
-      break;
+      return LPD8806VDCodec<1>::Color(r, g, b);
     case 2:
-      packedColor = 0x0000ffff &
-                    ((uint16_t)(r & 0b11111000) << 7 |
-                     (uint16_t)(g & 0b11111000) << 2 |
-                     (uint16_t)(b & 0b11111000) >> 3);
-      break;
+      return LPD8806VDCodec<2>::Color(r, g, b);
     case 3:
-      packedColor = 0x00ffffff &
-                    ((uint32_t)(g) << (16 - 1) |
-                     (uint32_t)(r) << (8 - 1) |
-                     (uint32_t)(b) >> 1);
-      break;
+      return LPD8806VDCodec<3>::Color(r, g, b);
   }
-  
-  return packedColor;
+
+  return 0;
 }
 
 
 // Sets a pixel's color, from R, G, B components.
-void LPD8806VD::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b)
+void LPD8806VD::setPixelColor(LPD8806VDIndex n, uint8_t r, uint8_t g, uint8_t b)
 {
   setPixelColor(n, Color(r, g, b));
 }
 
 
 // Sets a pixel's color directly (8 and 16 bit colors are NOT in GRB format).
-// color is expected to be in packed format.
-void LPD8806VD::setPixelColor(uint16_t n, uint32_t color)
+// color is expected to be in packed format (a palette index, with indexed color).
+void LPD8806VD::setPixelColor(LPD8806VDIndex n, uint32_t color)
 {
   uint8_t *p = &pixels[n * colorDepth];
 
+  LPD8806VD_STAT(stats.pixelWrites++);
+
+  if (paletteBits == 4)
+  {
+    setIndex4(n, color);
+    changed(n, 1);
+    return;
+  }
+
   switch (colorDepth)
   {
     case 1:
-      *p   = color;
+      LPD8806VDCodec<1>::store(p, color);
       break;
     case 2:
-      *p++ = color >> 8;
-      *p   = color;
+      LPD8806VDCodec<2>::store(p, color);
       break;
     case 3:
       // Store in GRB Ready-To-Go(tm) format
-      *p++ = (color >> 16);
-      *p++ = (color >> 8);
-      *p   = color;
+      LPD8806VDCodec<3>::store(p, color);
       break;
   }
+
+  changed(n, 1);
 }
 
 
-// Query color from previously-set pixel.
-uint32_t LPD8806VD::getPixelColor(uint16_t n)
+// Note that pixels first..first+count-1 changed: bump the dirty
+// high-water mark and bring the wire buffer up to date.
+void LPD8806VD::changed(LPD8806VDIndex first, LPD8806VDIndex count)
 {
-  uint8_t *ptr;
-  uint8_t  r, g, b;
-  uint16_t color16;
+  if (first + count > dirtyEnd)
+    dirtyEnd = first + count;
+
+  if (wire != NULL)
+  {
+    if (sending || wireStale)
+      wireStale = true;                     // Re-encode at next show
+    else
+      encodePixels(first, count, &wire[first * 3]);
+  }
+}
 
 
+// Query color from previously-set pixel.
+uint32_t LPD8806VD::getPixelColor(LPD8806VDIndex n)
+{
+  const uint8_t *ptr;
+
   if (n < numLEDs)
   {
-    // first, let's get our components
+    if (paletteBits == 4)
+      return getIndex4(n);
+
     ptr = &pixels[n * colorDepth];
 
+    // get the components, make them 256 value components, and
+    // return the packed value.
     switch (colorDepth)
     {
       case 1:
-        g = getGreen8(*ptr);
-        r = getRed8(*ptr);
-        b = getBlue8(*ptr);
-        break;
+        return LPD8806VDCodec<1>::getPixelColor(ptr);
       case 2:
-        color16 = ((uint16_t)(*ptr) << 8) | (uint16_t)(*(ptr + 1));
-        g = getGreen16(color16);
-        r = getRed16(color16);
-        b = getBlue16(color16);
-        break;
+        return LPD8806VDCodec<2>::getPixelColor(ptr);
       case 3:
-        g = *ptr;
-        r = *(ptr + 1);
-        b = *(ptr + 2);
-        break;
+        return LPD8806VDCodec<3>::getPixelColor(ptr);
     }
-    
-    // now make them 256 value components
-    
-    g <<= 1;
-    r <<= 1;
-    b <<= 1;
-    
-    // and finally, return the packed value.
-    
-    return Color(r, g, b);
   }
 
   return 0; // Pixel # is out of bounds
 }
 
+
+// Set count pixels, starting at pixel first, to packed color c.
+// By default, fills the whole strip.
+void LPD8806VD::fill(uint32_t c, LPD8806VDIndex first, LPD8806VDIndex count)
+{
+  uint8_t *p = &pixels[first * colorDepth];
+  LPD8806VDIndex size, done;
+
+  if (first >= numLEDs)
+    return;
+  if (count > numLEDs - first)
+    count = numLEDs - first;
+  if (count == 0)
+    return;
+
+  if (paletteBits == 4)
+  {
+    // Odd pixels at either end, then two pixels per byte
+    c &= 0x0f;
+    if (first & 1)
+      setIndex4(first, c);
+    if ((first + count) & 1)
+      setIndex4(first + count - 1, c);
+    memset(&pixels[(first + 1) >> 1], (c << 4) | c, ((first + count) >> 1) - ((first + 1) >> 1));
+    changed(first, count);
+    return;
+  }
+
+  size = count * colorDepth;
+
+  switch (colorDepth)
+  {
+    case 1:
+      LPD8806VDCodec<1>::store(p, c);
+      break;
+    case 2:
+      LPD8806VDCodec<2>::store(p, c);
+      break;
+    case 3:
+      LPD8806VDCodec<3>::store(p, c);
+      break;
+  }
+
+  // All the bytes of the color the same (e.g. black, white): one memset.
+  // Otherwise, keep doubling up the run already filled.
+  if (p[0] == p[colorDepth - 1] && p[0] == p[colorDepth >> 1])
+  {
+    memset(p, p[0], size);
+  }
+  else
+  {
+    for (done = colorDepth; done < size; done *= 2)
+      memcpy(p + done, p, (done < size - done) ? done : size - done);
+  }
+
+  changed(first, count);
+}
+
+
+// Set count pixels, starting at pixel first, from an array of packed colors.
+void LPD8806VD::setPixels(LPD8806VDIndex first, const uint32_t *colors, LPD8806VDIndex count)
+{
+  uint8_t *p = &pixels[first * colorDepth];
+  LPD8806VDIndex i;
+
+  if (first >= numLEDs)
+    return;
+  if (count > numLEDs - first)
+    count = numLEDs - first;
+
+  if (paletteBits == 4)
+  {
+    for (i = 0; i < count; i++)
+      setIndex4(first + i, colors[i]);
+    changed(first, count);
+    return;
+  }
+
+  switch (colorDepth)
+  {
+    case 1:
+      for (i = count; i; i--, p += 1)
+        LPD8806VDCodec<1>::store(p, *colors++);
+      break;
+    case 2:
+      for (i = count; i; i--, p += 2)
+        LPD8806VDCodec<2>::store(p, *colors++);
+      break;
+    case 3:
+      for (i = count; i; i--, p += 3)
+        LPD8806VDCodec<3>::store(p, *colors++);
+      break;
+  }
+
+  changed(first, count);
+}
+
+
+// Copy count pixels from pixel src to pixel dst.  The ranges may overlap.
+void LPD8806VD::copyRange(LPD8806VDIndex dst, LPD8806VDIndex src, LPD8806VDIndex count)
+{
+  if (dst >= numLEDs || src >= numLEDs)
+    return;
+  if (count > numLEDs - dst)
+    count = numLEDs - dst;
+  if (count > numLEDs - src)
+    count = numLEDs - src;
+
+  if (paletteBits == 4)
+  {
+    LPD8806VDIndex i;
+
+    if (dst < src)
+      for (i = 0; i < count; i++)
+        setIndex4(dst + i, getIndex4(src + i));
+    else
+      for (i = count; i; i--)
+        setIndex4(dst + i - 1, getIndex4(src + i - 1));
+  }
+  else
+  {
+    memmove(&pixels[dst * colorDepth], &pixels[src * colorDepth], count * colorDepth);
+  }
+
+  changed(dst, count);
+}
+
+
+// Move all pixels k places along the strip (towards the far end for
+// positive k), wrapping around at the ends.
+void LPD8806VD::rotate(LPD8806VDOffset k)
+{
+  uint8_t  tmp[LPD8806VD_CHUNK * 3];
+  LPD8806VDIndex size = numLEDs * colorDepth;
+  LPD8806VDIndex m;                 // Bytes to move to the front
+  uint8_t *a, *b, t;
+
+  if (numLEDs == 0)
+    return;
+
+  k %= (LPD8806VDOffset)numLEDs;
+  if (k < 0)
+    k += numLEDs;
+  if (k == 0)
+    return;
+
+  if (paletteBits == 4)
+  {
+    // Reverse the whole thing, then each part, a pixel at a time
+    reverse4(0, numLEDs);
+    reverse4(0, k);
+    reverse4(k, numLEDs);
+    changed(0, numLEDs);
+    return;
+  }
+
+  m = k * colorDepth;
+
+  if (m <= sizeof(tmp))
+  {
+    // Short rotations (scrolling): through a small temporary
+    memcpy(tmp, pixels + size - m, m);
+    memmove(pixels + m, pixels, size - m);
+    memcpy(pixels, tmp, m);
+  }
+  else if ((LPD8806VDIndex)(size - m) <= sizeof(tmp))
+  {
+    memcpy(tmp, pixels, size - m);
+    memmove(pixels, pixels + size - m, m);
+    memcpy(pixels + m, tmp, size - m);
+  }
+  else
+  {
+    // Long rotations: reverse the whole thing, then each part
+    for (a = pixels, b = pixels + size - 1; a < b; a++, b--)
+      t = *a, *a = *b, *b = t;
+    for (a = pixels, b = pixels + m - 1; a < b; a++, b--)
+      t = *a, *a = *b, *b = t;
+    for (a = pixels + m, b = pixels + size - 1; a < b; a++, b--)
+      t = *a, *a = *b, *b = t;
+  }
+
+  changed(0, numLEDs);
+}
+
+
+// Move all pixels k places along the strip (towards the far end for
+// positive k), filling in with black.
+void LPD8806VD::shift(LPD8806VDOffset k)
+{
+  LPD8806VDIndex size = numLEDs * colorDepth;
+  LPD8806VDIndex m;
+
+  if (k == 0)
+    return;
+
+  if (paletteBits == 4)
+  {
+    if (k >= (LPD8806VDOffset)numLEDs || -k >= (LPD8806VDOffset)numLEDs)
+    {
+      fill(0);
+    }
+    else if (k > 0)
+    {
+      copyRange(k, 0, numLEDs - k);
+      fill(0, 0, k);
+    }
+    else
+    {
+      copyRange(0, -k, numLEDs + k);
+      fill(0, numLEDs + k, -k);
+    }
+    return;
+  }
+
+  if (k >= (LPD8806VDOffset)numLEDs || -k >= (LPD8806VDOffset)numLEDs)
+  {
+    memset(pixels, 0, size);
+  }
+  else if (k > 0)
+  {
+    m = k * colorDepth;
+    memmove(pixels + m, pixels, size - m);
+    memset(pixels, 0, m);
+  }
+  else
+  {
+    m = -k * colorDepth;
+    memmove(pixels, pixels + m, size - m);
+    memset(pixels + size - m, 0, m);
+  }
+
+  changed(0, numLEDs);
+}
+
+
+// Mix n packed pixels from a and b into out: w = 0 (all a) .. 256 (all b).
+void LPD8806VD::mixPixels(uint8_t *out, const uint8_t *a, const uint8_t *b, uint16_t w)
+{
+  switch (colorDepth)
+  {
+    case 1:
+      LPD8806VDCodec<1>::mix(out, a, b, numLEDs, w);
+      break;
+    case 2:
+      LPD8806VDCodec<2>::mix(out, a, b, numLEDs, w);
+      break;
+    case 3:
+      LPD8806VDCodec<3>::mix(out, a, b, numLEDs, w);
+      break;
+  }
+}
+
+
+// Scale every pixel towards black: 255 = unchanged, 0 = black.
+// Works on the packed pixels directly (no decode/re-encode per pixel).
+// Direct color only; does nothing with indexed color.
+void LPD8806VD::fadeAll(uint8_t scale)
+{
+  uint16_t w = scale + (scale >> 7);
+
+  if (paletteBits || pixels == NULL)
+    return;
+
+  switch (colorDepth)
+  {
+    case 1:
+      LPD8806VDCodec<1>::scale(pixels, numLEDs, w);
+      break;
+    case 2:
+      LPD8806VDCodec<2>::scale(pixels, numLEDs, w);
+      break;
+    case 3:
+      LPD8806VDCodec<3>::scale(pixels, numLEDs, w);
+      break;
+  }
+
+  changed(0, numLEDs);
+}
+
+
+// Mix src into dst by alpha: 0 = dst unchanged, 255 = src.
+// dst and src are numPixels() packed pixels in this strip's color depth
+// (dst may be the pixel buffer).  Direct color only.
+void LPD8806VD::blend(uint8_t *dst, const uint8_t *src, uint8_t alpha)
+{
+  if (paletteBits || dst == NULL || src == NULL)
+    return;
+
+  mixPixels(dst, dst, src, alpha + (alpha >> 7));
+  if (dst == pixels)
+    changed(0, numLEDs);
+}
+
+
+// Set the pixels to a mix of frames a and b: t = 0 gives a, 255 gives b.
+// a and b are numPixels() packed pixels in this strip's color depth.
+// Direct color only.
+void LPD8806VD::crossfade(const uint8_t *a, const uint8_t *b, uint8_t t)
+{
+  if (paletteBits || pixels == NULL || a == NULL || b == NULL)
+    return;
+
+  mixPixels(pixels, a, b, t + (t >> 7));
+  changed(0, numLEDs);
+}
+
+
+// Use indexed color.
+// Each pixel is a 4 or 8 bit (bits) index into the palette pal, which
+// holds (1 << bits) entries of 3 bytes each, in the 24 bit GRB format
+// (0ggggggg 0rrrrrrr 0bbbbbbb).  Changing an entry recolors every pixel
+// using it at the next show, without touching the pixel buffer.
+// With 4 bit indexes, the pixel buffer needs (numPixels() + 1) / 2 bytes
+// (two pixels per byte, first pixel in the upper nibble).  With 8 bit
+// indexes, one byte per pixel.
+// The constructors clear the buffer for their color depth, so for a 4
+// bit buffer, construct with depth 4 (or with no buffer, then call
+// setPalette(pal, 4), then setBufferPointer(buf)).
+// setPixelColor()/getPixelColor() take/return palette indexes, and Color()
+// returns the index of the closest palette entry.
+// setPalette(NULL, 0) goes back to 8 bit direct color; setColorDepth()
+// goes back to any direct color depth.
+void LPD8806VD::setPalette(uint8_t *pal, uint8_t bits)
+{
+  if (pal == NULL || (bits != 4 && bits != 8))
+  {
+    pal  = NULL;
+    bits = 0;
+  }
+
+  palette     = pal;
+  paletteBits = bits;
+  colorDepth  = 1;
+  setDirty(numLEDs);
+  wireStale   = true;
+}
+
+
+// Change a palette entry, from R, G, B components.
+void LPD8806VD::setPaletteColor(uint8_t i, uint8_t r, uint8_t g, uint8_t b)
+{
+  if (palette == NULL)
+    return;
+
+  LPD8806VDCodec<3>::store(&palette[i * 3], LPD8806VDCodec<3>::Color(r, g, b));
+
+  // Every pixel could be using it
+  setDirty(numLEDs);
+  wireStale = true;
+}
+
+
+// Change a palette entry, from a 24 bit RGB color.
+void LPD8806VD::setPaletteColor(uint8_t i, uint32_t color)
+{
+  setPaletteColor(i, color >> 16, color >> 8, color);
+}
+
+
+// Palette entry, in 24 bit (GRB) packed format.
+uint32_t LPD8806VD::getPaletteColor(uint8_t i)
+{
+  if (palette == NULL)
+    return 0;
+
+  return LPD8806VDCodec<3>::getPixelColor(&palette[i * 3]);
+}
+
+
+// Index of the palette entry closest to R, G, B.
+uint8_t LPD8806VD::closestPaletteIndex(uint8_t r, uint8_t g, uint8_t b)
+{
+  uint16_t entries = 1 << paletteBits;
+  uint16_t i;
+  uint8_t  best = 0;
+  uint32_t bestDistance = 0xffffffff;
+  uint32_t distance;
+  int16_t  dg, dr, db;
+  const uint8_t *e = palette;
+
+  if (palette == NULL)
+    return 0;
+
+  for (i = 0; i < entries; i++, e += 3)
+  {
+    dg = (int16_t)(e[0] & 0x7f) - (g >> 1);
+    dr = (int16_t)(e[1] & 0x7f) - (r >> 1);
+    db = (int16_t)(e[2] & 0x7f) - (b >> 1);
+    distance = (uint32_t)(dg * dg) + (uint32_t)(dr * dr) + (uint32_t)(db * db);
+    if (distance < bestDistance)
+    {
+      bestDistance = distance;
+      best = i;
+      if (distance == 0)
+        break;
+    }
+  }
+
+  return best;
+}
+
+
+// Size of the pixel buffer, in bytes.
+LPD8806VDIndex LPD8806VD::bufferSize(void)
+{
+  if (paletteBits == 4)
+    return (numLEDs + 1) / 2;
+  return numLEDs * colorDepth;
+}
+
+
+// Set a 4 bit palette index.
+void LPD8806VD::setIndex4(LPD8806VDIndex n, uint8_t i)
+{
+  uint8_t *p = &pixels[n >> 1];
+
+  if (n & 1)
+    *p = (*p & 0xf0) | (i & 0x0f);
+  else
+    *p = (*p & 0x0f) | (i << 4);
+}
+
+
+// Reverse 4 bit pixels first..end-1.
+void LPD8806VD::reverse4(LPD8806VDIndex first, LPD8806VDIndex end)
+{
+  uint8_t t;
+
+  while (end > first + 1)
+  {
+    end--;
+    t = getIndex4(first);
+    setIndex4(first, getIndex4(end));
+    setIndex4(end, t);
+    first++;
+  }
+}
+
+
+// Set the 128 byte output level table, needed for setBrightness() and
+// setGamma().  Each 7 bit component is mapped through the table as it
+// is encoded for the wire, so the pixel buffer keeps full precision and
+// a brightness change costs nothing until the next show.
+// NULL turns brightness/gamma off.
+void LPD8806VD::setLevelBuffer(uint8_t *buf)
+{
+  levels = buf;
+  updateLevels();
+}
+
+
+// Set the output brightness, 0-255 (255 = full).
+void LPD8806VD::setBrightness(uint8_t b)
+{
+  brightness = b;
+  updateLevels();
+}
+
+
+// Turn output gamma correction on/off.
+void LPD8806VD::setGamma(boolean on)
+{
+  gamma = on;
+  updateLevels();
+}
+
+
+// Dither the output: each channel is worked out to 1/16th of an output
+// step (the low depth values are stretched to full scale, then gamma
+// and brightness are applied, if there is a level buffer), and the
+// fraction is turned into an occasional extra step:
+//   LPD8806VD_DITHER_ORDERED   by a threshold pattern that changes every
+//                              frame (no memory needed)
+//   LPD8806VD_DITHER_SPATIAL   by carrying the error along the strip
+//   LPD8806VD_DITHER_TEMPORAL  by carrying each pixel's error to the next
+//                              frame; needs an errors buffer of
+//                              LPD8806VD_DITHER_SIZE(numPixels()) bytes
+// Dithering works over a number of frames, so show often (e.g. with
+// LPD8806VDScheduler).  While it is on, every show() encodes the pixels
+// again (the wire buffer is not reused), and isDirty() is always 'true'
+// so a static image keeps being shown.
+void LPD8806VD::setDither(uint8_t mode, uint8_t *errors)
+{
+  if (mode > LPD8806VD_DITHER_TEMPORAL || (mode == LPD8806VD_DITHER_TEMPORAL && errors == NULL))
+    mode = LPD8806VD_DITHER_OFF;
+
+  waitShow();
+  dither    = mode;
+  ditherErr = errors;
+  if (errors != NULL)
+    memset(errors, 0, LPD8806VD_DITHER_SIZE(numLEDs));
+  setDirty(numLEDs);
+  wireStale = true;
+}
+
+
+// Bit-reversed counter: spreads thresholds evenly over 16 frames.
+static const uint8_t ditherPattern[16] =
+{
+  0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15
+};
+
+// Encode pixels into wire format, dithered (see setDither()).
+void LPD8806VD::encodeDither(LPD8806VDIndex first, LPD8806VDIndex count, uint8_t *out)
+{
+  uint8_t  width[3];
+  LPD8806VDIndex len = count * 3;
+  LPD8806VDIndex k = first * 3;
+  uint16_t p, g0, g1;
+  uint8_t  c, f, w, t, *e;
+  int8_t   bits;
+  LPD8806VD_STAT(uint32_t tm = micros());
+
+  if (paletteBits == 4)
+    encodeRun(&pixels[first >> 1], first & 1, count, out);
+  else
+    encodeRun(&pixels[first * colorDepth], 0, count, out);
+
+  // Field widths of G, R, B in the stored format
+  if (paletteBits != 0 || colorDepth == 3)
+    width[0] = width[1] = width[2] = 7;
+  else if (colorDepth == 2)
+    width[0] = width[1] = width[2] = 5;
+  else
+  {
+    width[0] = width[1] = 3;
+    width[2] = 2;
+  }
+
+  if (first == 0)
+  {
+    ditherAcc[0] = ditherPattern[ditherFrame & 15];
+    ditherAcc[1] = ditherPattern[(ditherFrame + 5) & 15];
+    ditherAcc[2] = ditherPattern[(ditherFrame + 10) & 15];
+  }
+
+  for (c = 0; len; len--, out++, k++, c = (c == 2) ? 0 : c + 1)
+  {
+    // Stretch the field to 11 bits (7.4 fixed point) by repeating it.
+    // A 7 bit field is already full scale: no fraction.
+    w = width[c];
+    f = (*out & 0x7f) >> (7 - w);
+    if (w == 7)
+      p = (uint16_t)f << 4;
+    else
+      for (p = 0, bits = 11; bits > 0; bits -= w)
+        p |= (bits >= w) ? (uint16_t)f << (bits - w) : f >> (w - bits);
+
+    // Output stage: gamma (interpolated) and brightness
+    if (levels != NULL)
+    {
+      if (gamma)
+      {
+        g0 = pgm_read_byte(&LPD8806VDGamma[p >> 4]);
+        g1 = (p >> 4) < 127 ? pgm_read_byte(&LPD8806VDGamma[(p >> 4) + 1]) : g0;
+        p  = (g0 << 4) + (g1 - g0) * (p & 15);
+      }
+      p = ((uint32_t)p * (brightness + 1)) >> 8;
+    }
+
+    // Round to 7 bits
+    switch (dither)
+    {
+      case LPD8806VD_DITHER_ORDERED:
+        t = ditherPattern[(ditherFrame + k * 7) & 15];
+        p += t;
+        break;
+      case LPD8806VD_DITHER_SPATIAL:
+        p += ditherAcc[c];
+        ditherAcc[c] = p & 15;
+        break;
+      case LPD8806VD_DITHER_TEMPORAL:
+        e  = &ditherErr[k >> 1];
+        t  = (k & 1) ? (*e & 0x0f) : (*e >> 4);
+        p += t;
+        *e = (k & 1) ? ((*e & 0xf0) | (p & 15)) : ((*e & 0x0f) | (p & 15) << 4);
+        break;
+    }
+
+    p >>= 4;
+    *out = (p > 127 ? 127 : p) | 0x80;
+  }
+
+  LPD8806VD_STAT(stats.encodeMicros += micros() - tm);
+}
+
+
+// Rebuild the output level table, and re-encode everything at next show.
+void LPD8806VD::updateLevels(void)
+{
+  uint8_t v;
+
+  if (levels != NULL)
+  {
+    for (v = 0; v < 128; v++)
+      levels[v] = ((uint16_t)(gamma ? pgm_read_byte(&LPD8806VDGamma[v]) : v) * (brightness + 1)) >> 8;
+  }
+
+  setDirty(numLEDs);
+  wireStale = true;
+}
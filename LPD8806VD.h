@@ -23,48 +23,157 @@
 ||
 */
 
-// Meh... Dunno if it works with Arduino, but hey, we'll put this in here.
-#if defined(WIRING)
- #include <Wiring.h>
-#elif ARDUINO >= 100
- #include <Arduino.h>
+#ifndef LPD8806VD_H
+#define LPD8806VD_H
+
+// Uncomment to enable background transmission with showAsync() on AVR
+// hardware SPI.  Note: this claims the SPI interrupt vector (SPI_STC_vect).
+//#define LPD8806VD_ASYNC
+
+// Uncomment to convert 8 and 16 bit colors to the wire format with lookup
+// tables instead of shifting and masking.  Costs 1792 bytes of flash
+// (PROGMEM on AVR).  Worth it on AVR, where multi-bit shifts are slow;
+// on parts with a barrel shifter, the arithmetic is about as fast.
+//#define LPD8806VD_USE_LUT
+
+// Uncomment to count frames, bytes sent, setPixelColor() calls and the
+// time spent encoding vs. sending (see getStats()).  Costs a couple of
+// micros() calls per chunk of pixels shown (setPixelColor() encoding into
+// a wire buffer is not timed); compiles to nothing when off.
+//#define LPD8806VD_STATS
+
+// Uncomment for 32 bit pixel indexes on AVR (strips over 65535 pixels, or
+// buffers over 64KB).  Other targets (and host builds) always use them.
+//#define LPD8806VD_LARGE
+
+#include "LPD8806VDTransport.h"
+#include "LPD8806VDCodec.h"
+
+#if !defined(__AVR__) && !defined(LPD8806VD_LARGE)
+ #define LPD8806VD_LARGE
+#endif
+
+// Pixel indexes/counts (and byte counts), and pixel offsets.
+#if defined(LPD8806VD_LARGE)
+ typedef uint32_t LPD8806VDIndex;
+ typedef int32_t  LPD8806VDOffset;
 #else
- #include <WProgram.h>
+ typedef uint16_t LPD8806VDIndex;
+ typedef int16_t  LPD8806VDOffset;
 #endif
 
+// Size of a wire-ready transmit buffer for a strip of n pixels:
+// 3 GRB bytes per pixel, followed by the "latch" zeros.
+#define LPD8806VD_WIRE_SIZE(n) ((n) * 3 + ((n) + 31) / 32)
+
+#if defined(LPD8806VD_STATS)
+// Counters kept with LPD8806VD_STATS enabled.
+// Times are from micros(), so each measurement is only as fine as its
+// resolution (4us on 16MHz AVRs).  Encoding is timed when a frame is
+// shown, not as setPixelColor() updates a wire buffer; with
+// LPD8806VDParallel, it is the sum over all its threads.
+struct LPD8806VDStats
+{
+  uint32_t frames;                                // Frames shown
+  uint32_t bytes;                                 // Bytes sent, latch bytes included
+  uint32_t encodeMicros;                          // Time converting pixels to wire format
+  uint32_t sendMicros;                            // Time handing bytes to the transport
+  uint32_t pixelWrites;                           // setPixelColor() calls since the last frame
+  uint32_t framePixelWrites;                      // setPixelColor() calls for the last frame
+};
+#endif
+
+// Dithering modes (see setDither())
+#define LPD8806VD_DITHER_OFF      0               // No dithering
+#define LPD8806VD_DITHER_ORDERED  1               // Threshold pattern, changing every frame
+#define LPD8806VD_DITHER_SPATIAL  2               // Error carried along the strip, per channel
+#define LPD8806VD_DITHER_TEMPORAL 3               // Error carried to the next frame, per pixel
+
+// Size of the error buffer for LPD8806VD_DITHER_TEMPORAL with n pixels
+// (4 bits per channel).
+#define LPD8806VD_DITHER_SIZE(n) (((n) * 3 + 1) / 2)
+
+// Fills buf with count packed pixels, starting at pixel first (see showStream()).
+typedef void (*LPD8806VDFill)(LPD8806VDIndex first, LPD8806VDIndex count, uint8_t *buf, void *ctx);
+
+// Returns pixel n as 7 bit GRB (see showShader()).
+typedef uint32_t (*LPD8806VDShader)(LPD8806VDIndex n, void *ctx);
+
 class LPD8806VD
 {
+  friend class LPD8806VDMulti;
+  friend class LPD8806VDParallel;
+
   public:
 
     // Constructors using Hardware SPI
     // Use SPI hardware; specific pins only
-    LPD8806VD(uint16_t n = 0, uint8_t depth = 3);  // Buffer not set
-    LPD8806VD(uint16_t n, uint8_t *buf, uint8_t depth = 3);
+    LPD8806VD(LPD8806VDIndex n = 0, uint8_t depth = 3);  // Buffer not set
+    LPD8806VD(LPD8806VDIndex n, uint8_t *buf, uint8_t depth = 3);
 
     // Constructors using bit-bang'd SPI
     // Configurable pins
-    LPD8806VD(uint16_t n, uint8_t dpin, uint8_t cpin, uint8_t depth = 3);  // Buffer not set
-    LPD8806VD(uint16_t n, uint8_t dpin, uint8_t cpin, uint8_t *buf, uint8_t depth = 3);
+    LPD8806VD(LPD8806VDIndex n, uint8_t dpin, uint8_t cpin, uint8_t depth = 3);  // Buffer not set
+    LPD8806VD(LPD8806VDIndex n, uint8_t dpin, uint8_t cpin, uint8_t *buf, uint8_t depth = 3);
+
+    // Constructor using any transport (see LPD8806VDTransport.h)
+    LPD8806VD(LPD8806VDIndex n, LPD8806VDTransport *t, uint8_t *buf, uint8_t depth = 3);
+
+    // depth is 1, 2 or 3 bytes per pixel, or 4 for 4 bit palette indexes
+    // ((n + 1) / 2 byte buffer; then setPalette(pal, 4)).  The buffer is
+    // cleared for that depth, so don't pass a 4 bit buffer with depth 1:
+    // pass depth 4, or no buffer, then setPalette(), then setBufferPointer().
 
     void begin(void);
     void clear(void);                             // Clear the pixel buffer
     void show(void);                              // Show all pixels
-    void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b);
-    void setPixelColor(uint16_t n, uint32_t c);   // Sets pixel to color (c is 8, 16, or 24 bit color)
+    void showAsync(void);                         // Show all pixels, in the background
+    void waitShow(void);                          // Wait for a background show to finish
+    boolean isBusy(void) { return sending; };     // Background show in progress?
+    void showDirty(void);                         // Show pixels up to the last one changed
+    void showStream(LPD8806VDFill fill, void *ctx = NULL);  // Show pixels from fill(), a chunk at a time
+    void showShader(LPD8806VDShader shader, void *ctx = NULL, uint8_t mix = 0);  // Show pixels from shader(), mixed with stored
+    boolean isDirty(void) { return dirtyEnd != 0 || dither != LPD8806VD_DITHER_OFF; };  // Any pixels changed since last show (or dithering)?
+    void setDirty(LPD8806VDIndex n);              // Mark pixels 0..n-1 as changed
+    void setPixelColor(LPD8806VDIndex n, uint8_t r, uint8_t g, uint8_t b);
+    void setPixelColor(LPD8806VDIndex n, uint32_t c);  // Sets pixel to color (c is 8, 16, or 24 bit color)
+    void fill(uint32_t c, LPD8806VDIndex first = 0, LPD8806VDIndex count = (LPD8806VDIndex)~0);  // Set a run of pixels to color c
+    void setPixels(LPD8806VDIndex first, const uint32_t *colors, LPD8806VDIndex count);  // Set a run of pixels from an array
+    void copyRange(LPD8806VDIndex dst, LPD8806VDIndex src, LPD8806VDIndex count);  // Copy pixels (ranges may overlap)
+    void rotate(LPD8806VDOffset k);               // Move pixels k places along the strip, wrapping
+    void shift(LPD8806VDOffset k);                // Move pixels k places along the strip, black in
+    void fadeAll(uint8_t scale);                  // Scale all pixels towards black (255 = unchanged)
+    void blend(uint8_t *dst, const uint8_t *src, uint8_t alpha);  // Mix packed frame src into dst
+    void crossfade(const uint8_t *a, const uint8_t *b, uint8_t t);  // Pixels = mix of packed frames a, b
 //    void setPixelColor24(uint16_t n, uint32_t c); // 24 bit color (packed RGB)
 //    void setPixelColor16(uint16_t n, uint16_t c); // 16 bit color
 //    void setPixelColor8(uint16_t n, uint8_t c);   // 8 bit color
     void updatePins(uint8_t dpin, uint8_t cpin);  // Change pins, configurable
     void updatePins(void);                        // Change pins, hardware SPI
-    void updateLength(uint16_t n);                // Change strip length
+    void setTransport(LPD8806VDTransport *t);     // Change to any transport
+    uint32_t setClock(uint32_t hz);               // Set the bit rate; returns the rate set (0 = fixed/unknown)
+    uint32_t calibrateClock(uint32_t maxHz = 20000000UL);  // Fastest rate that reads back intact
+    void updateLength(LPD8806VDIndex n);          // Change strip length
     void setBufferPointer(uint8_t *buf);          // Change the buffer
-    void setColorDepth(uint8_t depth);            // Change the color depth
+    void setColorDepth(uint8_t depth);            // Change the color depth (4 = 4 bit palette indexes)
+    void setPalette(uint8_t *pal, uint8_t bits);  // Indexed color: 4 or 8 bit indexes into pal
+    void setPaletteColor(uint8_t i, uint8_t r, uint8_t g, uint8_t b);  // Change a palette entry
+    void setPaletteColor(uint8_t i, uint32_t color);  // Change a palette entry (24 bit RGB)
+    uint32_t getPaletteColor(uint8_t i);          // Palette entry, in 24 bit (GRB) packed format
+    uint8_t getPaletteBits(void) { return paletteBits; };  // 0 = direct color
+    void setLevelBuffer(uint8_t *buf);            // 128 byte output level table, for brightness/gamma
+    void setBrightness(uint8_t b);                // Output brightness, 0-255 (255 = full)
+    uint8_t getBrightness(void) { return brightness; };
+    void setGamma(boolean on);                    // Output gamma correction on/off
+    void setDither(uint8_t mode, uint8_t *errors = NULL);  // Dither output to 7 bits (errors: TEMPORAL only)
+    void setWireBuffer(uint8_t *buf);             // Set a wire-ready buffer (NULL to disable)
+    void encode(void);                            // Re-encode pixel buffer into wire buffer
 
     uint8_t getColorDepth(void) { return colorDepth; };
-    uint16_t numPixels(void) { return numLEDs; };
+    LPD8806VDIndex numPixels(void) { return numLEDs; };
     uint32_t Color(uint32_t color);               // Convert a 24 RGB to a packed color
     uint32_t Color(uint8_t, uint8_t, uint8_t);    // Convert RGB components to packed color
-    uint32_t getPixelColor(uint16_t n);
+    uint32_t getPixelColor(LPD8806VDIndex n);
 
     uint16_t Color8To16(uint8_t c8);
 
@@ -81,21 +190,67 @@ class LPD8806VD
     uint8_t getGreen16(uint16_t c16);
     uint8_t getBlue16(uint16_t c16);
 
+#if defined(LPD8806VD_STATS)
+    const LPD8806VDStats &getStats(void) { return stats; };
+    void resetStats(void);
+#endif
+
+    // Called from the SPI interrupt when LPD8806VD_ASYNC is enabled.
+    static void handleInterrupt(void);
+
   private:
 
     uint8_t colorDepth;                           // 1 = 8 bit, 2 = 16 bit, 3 = 24/32 bit
-    uint16_t numLEDs;                             // Number of RGB LEDs in strip
-    uint8_t latchBytes;                           // Bytes to clear "latch"
+    LPD8806VDIndex numLEDs;                       // Number of RGB LEDs in strip
+    LPD8806VDIndex latchBytes;                    // Bytes to clear "latch"
+    LPD8806VDIndex dirtyEnd;                      // Pixels changed since last show (high-water)
     uint8_t *pixels;                              // Holds LED color values
-    uint8_t clkpin, datapin;                      // Clock & data pin numbers
-    uint8_t clkpinmask, datapinmask;              // Clock & data PORT bitmasks
-    volatile uint8_t *clkport, *dataport;         // Clock & data PORT registers
+    uint8_t *wire;                                // Wire-ready GRB|0x80 bytes + latch (optional)
+    uint8_t *palette;                             // Indexed color palette, GRB (optional)
+    uint8_t paletteBits;                          // 0 = direct color, 4 or 8 = indexed color
+    uint8_t *levels;                              // Output level table (optional)
+    uint8_t brightness;                           // Output brightness, 0-255
+    boolean gamma;                                // If 'true', output is gamma corrected
+    uint8_t dither;                               // Dithering mode
+    uint8_t ditherFrame;                          // Frame count, for the dither pattern
+    uint8_t ditherAcc[3];                         // Spatial dither error, per channel
+    uint8_t *ditherErr;                           // Temporal dither error, 4 bits per channel
+    LPD8806VDTransport *transport;                // Where the bytes go
+#if !defined(LPD8806VD_HOST)
+    LPD8806VDHardwareSPI spi;                     // Hardware SPI transport
+    LPD8806VDBitbang bitbang;                     // Bit-bang'd SPI transport
+#endif
 
-    void sendBitBangByte(uint8_t data);
-    void startBitbang(void);
-    void startSPI(void);
+    const uint8_t * volatile asyncPtr;            // Next byte to send in background
+    volatile LPD8806VDIndex asyncLeft;            // Bytes left to send in background
+    volatile boolean sending;                     // If 'true', background show running
+    boolean wireStale;                            // If 'true', wire buffer needs encode()
+    static LPD8806VD *asyncStrip;                 // Strip being sent in background
+#if defined(LPD8806VD_STATS)
+    LPD8806VDStats stats;
+    void statsFrame(void);
+#endif
+
+    void init(LPD8806VDIndex n, uint8_t *buf, uint8_t depth);
+    void encodePixels(LPD8806VDIndex first, LPD8806VDIndex count, uint8_t *out);
+    void encodeRun(const uint8_t *ptr, uint8_t odd, LPD8806VDIndex count, uint8_t *out);
+    void applyLevels(uint8_t *out, LPD8806VDIndex len);
+    void encodeDither(LPD8806VDIndex first, LPD8806VDIndex count, uint8_t *out);
+    void mixPixels(uint8_t *out, const uint8_t *a, const uint8_t *b, uint16_t w);
+    void changed(LPD8806VDIndex first, LPD8806VDIndex count);
+    LPD8806VDIndex bufferSize(void);
+    void updateLevels(void);
+    uint8_t getIndex4(LPD8806VDIndex n) { return (pixels[n >> 1] >> ((n & 1) ? 0 : 4)) & 0x0f; };
+    void setIndex4(LPD8806VDIndex n, uint8_t i);
+    void reverse4(LPD8806VDIndex first, LPD8806VDIndex end);
+    uint8_t closestPaletteIndex(uint8_t r, uint8_t g, uint8_t b);
+    void sendPixels(LPD8806VDIndex end);
+    void sendBytes(const uint8_t *data, LPD8806VDIndex len);
+    void sendZeros(LPD8806VDIndex len);
+    void useTransport(LPD8806VDTransport *t);
 
     boolean hardwareSPI; // If 'true', using hardware SPI
     boolean begun;       // If 'true', begin() method was previously invoked
 };
 
+#endif
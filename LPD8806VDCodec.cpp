@@ -0,0 +1,60 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Gamma table, and wire format lookup tables for 8 and 16 bit colors
+|| | (only built with LPD8806VD_USE_LUT, see LPD8806VD.h).
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#include "LPD8806VD.h"
+
+// 7 bit gamma correction: 127 * (v / 127) ^ 2.5
+const uint8_t LPD8806VDGamma[128] PROGMEM =
+{
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,   1,
+    1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   3,   3,   3,   3,   4,
+    4,   4,   5,   5,   5,   6,   6,   7,   7,   8,   8,   8,   9,   9,  10,  11,
+   11,  12,  12,  13,  14,  14,  15,  16,  16,  17,  18,  19,  19,  20,  21,  22,
+   23,  24,  25,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  38,  39,
+   40,  41,  43,  44,  45,  47,  48,  49,  51,  52,  54,  55,  57,  58,  60,  61,
+   63,  65,  66,  68,  70,  72,  73,  75,  77,  79,  81,  83,  85,  87,  89,  91,
+   93,  95,  97,  99, 101, 103, 106, 108, 110, 113, 115, 117, 120, 122, 125, 127
+};
+
+
+#if defined(LPD8806VD_USE_LUT)
+
+// Expand a table entry macro for every byte value.
+#define LPD8806VD_LUT4(E, c)   E(c), E(c + 1), E(c + 2), E(c + 3)
+#define LPD8806VD_LUT16(E, c)  LPD8806VD_LUT4(E, c), LPD8806VD_LUT4(E, c + 4), LPD8806VD_LUT4(E, c + 8), LPD8806VD_LUT4(E, c + 12)
+#define LPD8806VD_LUT64(E, c)  LPD8806VD_LUT16(E, c), LPD8806VD_LUT16(E, c + 16), LPD8806VD_LUT16(E, c + 32), LPD8806VD_LUT16(E, c + 48)
+#define LPD8806VD_LUT256(E)    LPD8806VD_LUT64(E, 0), LPD8806VD_LUT64(E, 64), LPD8806VD_LUT64(E, 128), LPD8806VD_LUT64(E, 192)
+
+// C8 = rrrgggbb -> G, R, B
+#define LPD8806VD_LUT8_ENTRY(c) \
+  (uint8_t)((((c) & 0b00011100) << 2) | 0x80), \
+  (uint8_t)((((c) & 0b11100000) >> 1) | 0x80), \
+  (uint8_t)((((c) & 0b00000011) << 5) | 0x80)
+
+// C16 high byte = 0rrrrrgg -> G (bits 6..5), R
+#define LPD8806VD_LUT16HI_ENTRY(c) \
+  (uint8_t)((((c) & 0b00000011) << 5) | 0x80), \
+  (uint8_t)(((c) & 0b01111100) | 0x80)
+
+// C16 low byte = gggbbbbb -> G (bits 4..2), B
+#define LPD8806VD_LUT16LO_ENTRY(c) \
+  (uint8_t)(((c) & 0b11100000) >> 3), \
+  (uint8_t)((((c) & 0b00011111) << 2) | 0x80)
+
+const uint8_t LPD8806VDLut8[256 * 3] PROGMEM = { LPD8806VD_LUT256(LPD8806VD_LUT8_ENTRY) };
+const uint8_t LPD8806VDLut16Hi[256 * 2] PROGMEM = { LPD8806VD_LUT256(LPD8806VD_LUT16HI_ENTRY) };
+const uint8_t LPD8806VDLut16Lo[256 * 2] PROGMEM = { LPD8806VD_LUT256(LPD8806VD_LUT16LO_ENTRY) };
+
+#endif
@@ -0,0 +1,451 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Packed color formats for LPD8806VD strips, one per color depth.
+|| | Each depth gets its own LPD8806VDCodec<depth>, so code that knows the
+|| | depth up front does no switching at all.
+|| |
+|| | C8  = rrrgggbb
+|| | C16 = 0rrrrrgg gggbbbbb (15-bit, 5:5:5)
+|| | C24 = direct color format for the LPD8806 (GRB)
+|| |     = 0ggggggg 0rrrrrrr 0bbbbbbb
+|| |     (the upper bit is set on the way out)
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#ifndef LPD8806VDCODEC_H
+#define LPD8806VDCODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__SSE2__)
+ #include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+ #include <tmmintrin.h>
+#endif
+#if defined(__ARM_NEON)
+ #include <arm_neon.h>
+#endif
+
+#if defined(__AVR__)
+ #include <avr/pgmspace.h>
+#endif
+#ifndef PROGMEM
+ #define PROGMEM
+#endif
+#ifndef pgm_read_byte
+ #define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#endif
+
+// 7 bit gamma correction (2.5) table
+extern const uint8_t LPD8806VDGamma[128] PROGMEM;
+
+#if defined(LPD8806VD_USE_LUT)
+// Wire format lookup tables (see LPD8806VDCodec.cpp)
+// C8 -> G, R, B (high bits set)
+extern const uint8_t LPD8806VDLut8[256 * 3] PROGMEM;
+// C16 high byte -> G (upper 2 bits, high bit set), R (high bit set)
+extern const uint8_t LPD8806VDLut16Hi[256 * 2] PROGMEM;
+// C16 low byte -> G (lower 3 bits), B (high bit set)
+extern const uint8_t LPD8806VDLut16Lo[256 * 2] PROGMEM;
+#endif
+
+#if defined(__SSE2__)
+// Interleave 16 G, 16 R and 16 B bytes into 48 wire bytes (G, R, B, ...).
+#if defined(__SSSE3__)
+// Each 16 bytes out is 3 byte shuffles.
+static inline void LPD8806VDStoreGRB(uint8_t *out, __m128i g, __m128i r, __m128i b)
+{
+  _mm_storeu_si128((__m128i *)out, _mm_or_si128(_mm_or_si128(
+    _mm_shuffle_epi8(g, _mm_setr_epi8( 0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1,  5)),
+    _mm_shuffle_epi8(r, _mm_setr_epi8(-1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1))),
+    _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1))));
+  _mm_storeu_si128((__m128i *)(out + 16), _mm_or_si128(_mm_or_si128(
+    _mm_shuffle_epi8(g, _mm_setr_epi8(-1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10, -1)),
+    _mm_shuffle_epi8(r, _mm_setr_epi8( 5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10))),
+    _mm_shuffle_epi8(b, _mm_setr_epi8(-1,  5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1))));
+  _mm_storeu_si128((__m128i *)(out + 32), _mm_or_si128(_mm_or_si128(
+    _mm_shuffle_epi8(g, _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1)),
+    _mm_shuffle_epi8(r, _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1))),
+    _mm_shuffle_epi8(b, _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15))));
+}
+#else
+// Pixels are unpacked to G, R, B, 0 and the zeros squeezed out, 4 pixels
+// (12 bytes) at a time.
+static inline __m128i LPD8806VDSqueezeGRB(__m128i x)
+{
+  x = _mm_or_si128(_mm_and_si128(x, _mm_set1_epi64x(0x0000000000FFFFFFLL)),
+                   _mm_and_si128(_mm_srli_epi64(x, 8), _mm_set1_epi64x(0x0000FFFFFF000000LL)));
+  return _mm_or_si128(_mm_and_si128(x, _mm_set_epi64x(0, 0x0000FFFFFFFFFFFFLL)),
+                      _mm_and_si128(_mm_srli_si128(x, 2), _mm_set_epi64x(0x00000000FFFFFFFFLL, (long long)0xFFFF000000000000ULL)));
+}
+
+static inline void LPD8806VDStoreGRB(uint8_t *out, __m128i g, __m128i r, __m128i b)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i gr = _mm_unpacklo_epi8(g, r);
+  __m128i b0 = _mm_unpacklo_epi8(b, zero);
+  __m128i x;
+
+  // Each store runs 4 bytes past its 12; the next one covers them.
+  _mm_storeu_si128((__m128i *)out,        LPD8806VDSqueezeGRB(_mm_unpacklo_epi16(gr, b0)));
+  _mm_storeu_si128((__m128i *)(out + 12), LPD8806VDSqueezeGRB(_mm_unpackhi_epi16(gr, b0)));
+  gr = _mm_unpackhi_epi8(g, r);
+  b0 = _mm_unpackhi_epi8(b, zero);
+  _mm_storeu_si128((__m128i *)(out + 24), LPD8806VDSqueezeGRB(_mm_unpacklo_epi16(gr, b0)));
+  x = LPD8806VDSqueezeGRB(_mm_unpackhi_epi16(gr, b0));
+  _mm_storel_epi64((__m128i *)(out + 36), x);
+  _mm_storel_epi64((__m128i *)(out + 40), _mm_srli_si128(x, 4));
+}
+#endif
+#endif
+
+template<uint8_t Depth> struct LPD8806VDCodec;
+
+
+// 8 bit color (1 byte per pixel).
+template<> struct LPD8806VDCodec<1>
+{
+  // LPD8806 (7 bit) components
+  static inline uint8_t red(uint8_t c8)   { return ((c8 & 0b11100000) >> 1); }
+  static inline uint8_t green(uint8_t c8) { return ((c8 & 0b00011100) << 2); }
+  static inline uint8_t blue(uint8_t c8)  { return ((c8 & 0b00000011) << 5); }
+
+  static inline uint32_t Color(uint8_t r, uint8_t g, uint8_t b)
+  {
+    return 0x000000ff &
+           ((r & 0b11100000) |
+            (g & 0b11100000) >> 3 |
+            (b & 0b11000000) >> 6);
+  }
+
+  static inline void store(uint8_t *p, uint32_t color)
+  {
+    *p = color;
+  }
+
+  // Decoding to components and re-packing with Color() gives back the
+  // stored value, so there's no need to do either.
+  static inline uint32_t getPixelColor(const uint8_t *p)
+  {
+    return *p;
+  }
+
+  // Wire format: G, R, B with the high bit set.
+  static inline void encode(const uint8_t *p, uint8_t *out)
+  {
+#if defined(LPD8806VD_USE_LUT)
+    const uint8_t *e = &LPD8806VDLut8[*p * 3];
+
+    out[0] = pgm_read_byte(e);
+    out[1] = pgm_read_byte(e + 1);
+    out[2] = pgm_read_byte(e + 2);
+#else
+    out[0] = green(*p) | 0x80;
+    out[1] = red(*p)   | 0x80;
+    out[2] = blue(*p)  | 0x80;
+#endif
+  }
+
+  // Wire format for n pixels, 16 at a time with SSE2 or NEON.
+  static inline void encodeBulk(const uint8_t *p, uint8_t *out, size_t n)
+  {
+#if defined(__SSE2__)
+    const __m128i top = _mm_set1_epi8((char)0x80);
+    __m128i v;
+
+    // Fields are masked before shifting, so nothing crosses into the
+    // next byte of the 16 bit lanes.
+    for (; n >= 16; n -= 16, p += 16, out += 48)
+    {
+      v = _mm_loadu_si128((const __m128i *)p);
+      LPD8806VDStoreGRB(out,
+        _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi8(0x1C)), 2), top),
+        _mm_or_si128(_mm_srli_epi16(_mm_and_si128(v, _mm_set1_epi8((char)0xE0)), 1), top),
+        _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi8(0x03)), 5), top));
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t top = vdupq_n_u8(0x80);
+    uint8x16x3_t grb;
+    uint8x16_t v;
+
+    for (; n >= 16; n -= 16, p += 16, out += 48)
+    {
+      v = vld1q_u8(p);
+      grb.val[0] = vorrq_u8(vshlq_n_u8(vandq_u8(v, vdupq_n_u8(0x1C)), 2), top);
+      grb.val[1] = vorrq_u8(vshrq_n_u8(vandq_u8(v, vdupq_n_u8(0xE0)), 1), top);
+      grb.val[2] = vorrq_u8(vshlq_n_u8(vandq_u8(v, vdupq_n_u8(0x03)), 5), top);
+      vst3q_u8(out, grb);
+    }
+#endif
+
+    for (; n; n--, p++, out += 3)
+      encode(p, out);
+  }
+
+  // Bulk fades and mixes, w = 0..256 (256 = all of b).
+  // SWAR: red and blue (0xE3) scale together in one multiply, green
+  // (0x1C) in another, with a 3 bit weight, so no field can carry into
+  // its neighbour.  The weight is rounded down, so only 256 keeps all of
+  // b (and a fade below 256 always darkens).
+  static inline void scale(uint8_t *p, size_t n, uint16_t w)
+  {
+    uint8_t s = w >> 5;
+
+    for (; n; n--, p++)
+      *p = ((((*p & 0xE3) * s) >> 3) & 0xE3) | ((((*p & 0x1C) * s) >> 3) & 0x1C);
+  }
+
+  static inline void mix(uint8_t *out, const uint8_t *a, const uint8_t *b, size_t n, uint16_t w)
+  {
+    uint8_t s = w >> 5;
+    uint8_t t = 8 - s;
+
+    for (; n; n--, out++, a++, b++)
+      *out = ((((*a & 0xE3) * t + (*b & 0xE3) * s) >> 3) & 0xE3) |
+             ((((*a & 0x1C) * t + (*b & 0x1C) * s) >> 3) & 0x1C);
+  }
+};
+
+
+// 16 bit color (2 bytes per pixel, high byte first).
+template<> struct LPD8806VDCodec<2>
+{
+  // LPD8806 (7 bit) components
+  static inline uint8_t red(uint16_t c16)   { return ((c16 & 0b0111110000000000) >> (8 + 0)); }
+  static inline uint8_t green(uint16_t c16) { return ((c16 & 0b0000001111100000) >> (2 + 1)); }
+  static inline uint8_t blue(uint16_t c16)  { return ((c16 & 0b0000000000011111) << (3 - 1)); }
+
+  static inline uint16_t load(const uint8_t *p)
+  {
+    return ((uint16_t)(*p) << 8) | (uint16_t)(*(p + 1));
+  }
+
+  static inline uint32_t Color(uint8_t r, uint8_t g, uint8_t b)
+  {
+    return 0x0000ffff &
+           ((uint16_t)(r & 0b11111000) << 7 |
+            (uint16_t)(g & 0b11111000) << 2 |
+            (uint16_t)(b & 0b11111000) >> 3);
+  }
+
+  static inline void store(uint8_t *p, uint32_t color)
+  {
+    *p++ = color >> 8;
+    *p   = color;
+  }
+
+  // Same as Color(red() << 1, green() << 1, blue() << 1)
+  static inline uint32_t getPixelColor(const uint8_t *p)
+  {
+    return load(p) & 0x7fff;
+  }
+
+  static inline void encode(const uint8_t *p, uint8_t *out)
+  {
+#if defined(LPD8806VD_USE_LUT)
+    const uint8_t *hi = &LPD8806VDLut16Hi[*p * 2];
+    const uint8_t *lo = &LPD8806VDLut16Lo[*(p + 1) * 2];
+
+    out[0] = pgm_read_byte(hi) | pgm_read_byte(lo);
+    out[1] = pgm_read_byte(hi + 1);
+    out[2] = pgm_read_byte(lo + 1);
+#else
+    uint16_t c16 = load(p);
+
+    out[0] = green(c16) | 0x80;
+    out[1] = red(c16)   | 0x80;
+    out[2] = blue(c16)  | 0x80;
+#endif
+  }
+
+  // Wire format for n pixels, 16 at a time with SSE2 or NEON.
+  static inline void encodeBulk(const uint8_t *p, uint8_t *out, size_t n)
+  {
+#if defined(__SSE2__)
+    // In 16 bit lanes, a pixel is (low byte << 8) | high byte.
+    const __m128i mask = _mm_set1_epi16(0x7C);
+    const __m128i top  = _mm_set1_epi8((char)0x80);
+    __m128i a, b;
+
+    for (; n >= 16; n -= 16, p += 32, out += 48)
+    {
+      a = _mm_loadu_si128((const __m128i *)p);
+      b = _mm_loadu_si128((const __m128i *)(p + 16));
+      LPD8806VDStoreGRB(out,
+        _mm_or_si128(_mm_packus_epi16(green(a), green(b)), top),
+        _mm_or_si128(_mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)), top),
+        _mm_or_si128(_mm_packus_epi16(_mm_and_si128(_mm_srli_epi16(a, 6), mask),
+                                      _mm_and_si128(_mm_srli_epi16(b, 6), mask)), top));
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t top = vdupq_n_u8(0x80);
+    uint8x16x2_t c;                             // High bytes, low bytes
+    uint8x16x3_t grb;
+
+    for (; n >= 16; n -= 16, p += 32, out += 48)
+    {
+      c = vld2q_u8(p);
+      grb.val[0] = vorrq_u8(vorrq_u8(vshlq_n_u8(vandq_u8(c.val[0], vdupq_n_u8(0x03)), 5),
+                                     vshrq_n_u8(vandq_u8(c.val[1], vdupq_n_u8(0xE0)), 3)), top);
+      grb.val[1] = vorrq_u8(vandq_u8(c.val[0], vdupq_n_u8(0x7C)), top);
+      grb.val[2] = vorrq_u8(vshlq_n_u8(vandq_u8(c.val[1], vdupq_n_u8(0x1F)), 2), top);
+      vst3q_u8(out, grb);
+    }
+#endif
+
+    for (; n; n--, p += 2, out += 3)
+      encode(p, out);
+  }
+
+#if defined(__SSE2__)
+  // green() of 8 pixels, as loaded (see encodeBulk()).
+  static inline __m128i green(__m128i v)
+  {
+    return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0x03)), 5),
+                        _mm_and_si128(_mm_srli_epi16(v, 11), _mm_set1_epi16(0x1C)));
+  }
+#endif
+
+  // Bulk fades and mixes, w = 0..256 (256 = all of b).
+  // SWAR: green (0x03E0) is moved up out of the way of red and blue
+  // (0x7C1F), then all three scale in one multiply with a 5 bit weight
+  // (rounded down, as for 8 bit).
+  static inline uint32_t spread(uint16_t c16)
+  {
+    return (c16 & 0x7C1F) | ((uint32_t)(c16 & 0x03E0) << 16);
+  }
+
+  static inline uint16_t unspread(uint32_t x)
+  {
+    x &= 0x7C1F | ((uint32_t)0x03E0 << 16);
+    return x | (x >> 16);
+  }
+
+  static inline void scale(uint8_t *p, size_t n, uint16_t w)
+  {
+    uint8_t s = w >> 3;
+
+    for (; n; n--, p += 2)
+      store(p, unspread((spread(load(p)) * s) >> 5));
+  }
+
+  static inline void mix(uint8_t *out, const uint8_t *a, const uint8_t *b, size_t n, uint16_t w)
+  {
+    uint8_t s = w >> 3;
+    uint8_t t = 32 - s;
+
+    for (; n; n--, out += 2, a += 2, b += 2)
+      store(out, unspread((spread(load(a)) * t + spread(load(b)) * s) >> 5));
+  }
+};
+
+
+// 24 bit color (3 bytes per pixel, GRB Ready-To-Go(tm) format).
+template<> struct LPD8806VDCodec<3>
+{
+  static inline uint32_t Color(uint8_t r, uint8_t g, uint8_t b)
+  {
+    return 0x00ffffff &
+           ((uint32_t)(g) << (16 - 1) |
+            (uint32_t)(r) << (8 - 1) |
+            (uint32_t)(b) >> 1);
+  }
+
+  static inline void store(uint8_t *p, uint32_t color)
+  {
+    *p++ = (color >> 16);
+    *p++ = (color >> 8);
+    *p   = color;
+  }
+
+  // Same as Color(r << 1, g << 1, b << 1)
+  static inline uint32_t getPixelColor(const uint8_t *p)
+  {
+    return (uint32_t)(*p & 0x7f) << 16 |
+           (uint32_t)(*(p + 1) & 0x7f) << 8 |
+           (uint32_t)(*(p + 2) & 0x7f);
+  }
+
+  static inline void encode(const uint8_t *p, uint8_t *out)
+  {
+    out[0] = p[0] | 0x80;
+    out[1] = p[1] | 0x80;
+    out[2] = p[2] | 0x80;
+  }
+
+  // Wire format for n pixels: every byte gets its high bit, so this
+  // works on n * 3 bytes (a loop compilers vectorize by themselves).
+  static inline void encodeBulk(const uint8_t *p, uint8_t *out, size_t n)
+  {
+    size_t len = n * 3;
+
+    for (; len; len--, p++, out++)
+      *out = *p | 0x80;
+  }
+
+  // Bulk fades and mixes, w = 0..256 (256 = all of b).
+  // Every byte is a 7 bit component, so these work on n * 3 bytes
+  // (16 at a time with SSE2).
+  static inline void scale(uint8_t *p, size_t n, uint16_t w)
+  {
+    uint32_t len = (uint32_t)n * 3;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_set1_epi8(0x7f);
+    const __m128i ws   = _mm_set1_epi16(w);
+    __m128i v, lo, hi;
+
+    for (; len >= 16; len -= 16, p += 16)
+    {
+      v  = _mm_and_si128(_mm_loadu_si128((const __m128i *)p), mask);
+      lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), ws), 8);
+      hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), ws), 8);
+      _mm_storeu_si128((__m128i *)p, _mm_packus_epi16(lo, hi));
+    }
+#endif
+
+    for (; len; len--, p++)
+      *p = ((*p & 0x7f) * w) >> 8;
+  }
+
+  static inline void mix(uint8_t *out, const uint8_t *a, const uint8_t *b, size_t n, uint16_t w)
+  {
+    uint32_t len = (uint32_t)n * 3;
+    uint16_t t = 256 - w;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_set1_epi8(0x7f);
+    const __m128i ws   = _mm_set1_epi16(w);
+    const __m128i ts   = _mm_set1_epi16(t);
+    __m128i va, vb, lo, hi;
+
+    for (; len >= 16; len -= 16, out += 16, a += 16, b += 16)
+    {
+      va = _mm_and_si128(_mm_loadu_si128((const __m128i *)a), mask);
+      vb = _mm_and_si128(_mm_loadu_si128((const __m128i *)b), mask);
+      lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), ts),
+                         _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), ws));
+      hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), ts),
+                         _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), ws));
+      _mm_storeu_si128((__m128i *)out, _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+#endif
+
+    for (; len; len--, out++, a++, b++)
+      *out = ((*a & 0x7f) * t + (*b & 0x7f) * w) >> 8;
+  }
+};
+
+#endif
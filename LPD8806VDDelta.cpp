@@ -0,0 +1,137 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Frame delta stream encoder and decoder for LPD8806VD.
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#include "LPD8806VDDelta.h"
+
+/*****************************************************************************/
+
+// Pixel i unchanged from prev to cur?
+static boolean same(const uint8_t *prev, const uint8_t *cur, LPD8806VDIndex i, uint8_t depth)
+{
+  return prev != NULL && memcmp(&prev[i * depth], &cur[i * depth], depth) == 0;
+}
+
+
+size_t LPD8806VDDeltaEncode(const uint8_t *prev, const uint8_t *cur, LPD8806VDIndex n, uint8_t depth, uint8_t *out)
+{
+  uint8_t *start = out;
+  LPD8806VDIndex i = 0;
+  LPD8806VDIndex j, k, run;
+
+  while (i < n)
+  {
+    // Unchanged pixels: skip them (not needed at the end of the strip).
+    for (j = i; j < n && same(prev, cur, j, depth); j++);
+    if (j == n)
+      break;
+    while (j - i > 127)
+    {
+      *out++ = 126;                    // Skip 127
+      i += 127;
+    }
+    if (j > i)
+      *out++ = j - i - 1;
+    i = j;
+
+    // Changed pixels, up to 128 at a time.  A short unchanged run in
+    // between is cheaper to resend than to skip (a skip and a new run
+    // cost 2 bytes).
+    k = i + 1;
+    while (k < n && k - i < 128)
+    {
+      if (!same(prev, cur, k, depth))
+      {
+        k++;
+        continue;
+      }
+      for (run = 1; k + run < n && same(prev, cur, k + run, depth); run++);
+      if (run * depth > 2 || k + run == n || k + run - i > 128)
+        break;
+      k += run;
+    }
+
+    *out++ = 0x80 | (k - i - 1);
+    memcpy(out, &cur[i * depth], (k - i) * depth);
+    out += (k - i) * depth;
+    i = k;
+  }
+
+  *out++ = LPD8806VD_DELTA_END;
+  return out - start;
+}
+
+
+/*****************************************************************************/
+
+LPD8806VDDeltaDecoder::LPD8806VDDeltaDecoder(LPD8806VD &s)
+{
+  strip = &s;
+  reset();
+}
+
+
+void LPD8806VDDeltaDecoder::reset(void)
+{
+  pos      = 0;
+  literals = 0;
+  got      = 0;
+  color    = 0;
+}
+
+
+// Take the next byte of the stream.
+// Pixels past the end of the strip are dropped.
+boolean LPD8806VDDeltaDecoder::write(uint8_t b)
+{
+  if (literals)
+  {
+    color = (color << 8) | b;
+    if (++got < strip->getColorDepth())
+      return false;
+
+    if (pos < strip->numPixels())
+      strip->setPixelColor(pos, color);
+    pos++;
+    literals--;
+    got   = 0;
+    color = 0;
+    return false;
+  }
+
+  if (b == LPD8806VD_DELTA_END)
+  {
+    pos = 0;
+    return true;
+  }
+
+  if (b & 0x80)
+    literals = (b & 0x7f) + 1;
+  else
+    pos += b + 1;
+
+  return false;
+}
+
+
+// Take a run of bytes, up to and including the end of a frame.
+size_t LPD8806VDDeltaDecoder::write(const uint8_t *data, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < len; )
+    if (write(data[i++]))
+      break;
+
+  return i;
+}
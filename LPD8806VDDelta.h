@@ -0,0 +1,68 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Compact frame delta stream, for feeding a strip over a slow link.
+|| |
+|| | Each frame only carries the pixels that changed since the last one:
+|| |   0x00-0x7E  skip the next n + 1 pixels (unchanged)
+|| |   0x7F       end of frame (back to pixel 0)
+|| |   0x80-0xFF  the next (n & 0x7F) + 1 pixels follow, each one
+|| |              getColorDepth() bytes of packed color, high byte first
+|| |              (as getPixelColor() returns it; indexed color: 1 byte)
+|| |
+|| | On the strip:
+|| |   LPD8806VDDeltaDecoder delta(strip);
+|| |   while (Serial.available())
+|| |     if (delta.write(Serial.read()))
+|| |       strip.showDirty();
+|| |
+|| | On the sender (the encoder builds anywhere, including host builds):
+|| |   len = LPD8806VDDeltaEncode(prev, frame, n, depth, out);
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#ifndef LPD8806VDDELTA_H
+#define LPD8806VDDELTA_H
+
+#include "LPD8806VD.h"
+
+#define LPD8806VD_DELTA_END 0x7F
+
+// Largest delta frame for n pixels of depth bytes (every pixel changed).
+#define LPD8806VD_DELTA_MAX(n, depth) ((n) * (depth) + ((n) + 127) / 128 + 1)
+
+// Writes the delta from prev to cur (n packed pixels of depth bytes, as
+// in the pixel buffer) to out, ending with LPD8806VD_DELTA_END.
+// prev = NULL sends every pixel.  Returns the bytes written, at most
+// LPD8806VD_DELTA_MAX(n, depth).
+size_t LPD8806VDDeltaEncode(const uint8_t *prev, const uint8_t *cur, LPD8806VDIndex n, uint8_t depth, uint8_t *out);
+
+
+// Decodes a delta stream into a strip, a byte at a time.
+// Pixels are stored with setPixelColor(), so they are marked changed
+// (for showDirty()) and the wire buffer, if any, is kept up to date.
+class LPD8806VDDeltaDecoder
+{
+  public:
+    LPD8806VDDeltaDecoder(LPD8806VD &strip);
+
+    boolean write(uint8_t b);                     // 'true' at the end of a frame
+    size_t write(const uint8_t *data, size_t len);  // Stops after the end of a frame; returns bytes used
+    void reset(void);                             // Drop any partial frame
+
+  private:
+    LPD8806VD *strip;
+    LPD8806VDIndex pos;                           // Next pixel
+    uint8_t literals;                             // Pixels left in the current run
+    uint8_t got;                                  // Bytes of the current pixel so far
+    uint32_t color;                               // Current pixel, so far
+};
+
+#endif
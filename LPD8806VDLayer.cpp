@@ -0,0 +1,433 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Layer compositing for LPD8806VD.
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#include "LPD8806VDLayer.h"
+
+// Pixels composited at a time (3 bytes each, on the stack).
+#define LPD8806VD_COMPOSE_CHUNK 16
+
+/*****************************************************************************/
+
+LPD8806VDLayer::LPD8806VDLayer(uint8_t *buf, LPD8806VDIndex n, LPD8806VDOffset o, uint8_t order)
+{
+  pixels      = buf;
+  length      = n;
+  offset      = o;
+  shownOffset = o;
+  shown       = false;
+  opacity     = 255;
+  blend       = LPD8806VD_BLEND_NORMAL;
+  z           = order;
+  added       = 0;
+  visible     = true;
+  moved       = true;
+  dirtyFirst  = 0;
+  dirtyEnd    = 0;
+  next        = NULL;
+  clear();
+}
+
+
+void LPD8806VDLayer::clear(void)
+{
+  memset(pixels, 0, length * 3);
+  changed(0, length);
+}
+
+
+void LPD8806VDLayer::setPixelColor(LPD8806VDIndex n, uint8_t r, uint8_t g, uint8_t b)
+{
+  uint8_t *p = &pixels[n * 3];
+
+  if (n >= length)
+    return;
+
+  p[0] = g >> 1;
+  p[1] = r >> 1;
+  p[2] = b >> 1;
+  changed(n, n + 1);
+}
+
+
+void LPD8806VDLayer::setPixelColor(LPD8806VDIndex n, uint32_t c)
+{
+  setPixelColor(n, c >> 16, c >> 8, c);
+}
+
+
+uint32_t LPD8806VDLayer::getPixelColor(LPD8806VDIndex n)
+{
+  const uint8_t *p = &pixels[n * 3];
+
+  if (n >= length)
+    return 0;
+
+  return (uint32_t)(p[1] << 1) << 16 | (uint32_t)(p[0] << 1) << 8 | (p[2] << 1);
+}
+
+
+void LPD8806VDLayer::setDirty(void)
+{
+  changed(0, length);
+}
+
+
+// The properties below change the whole layer (and where it was).
+
+void LPD8806VDLayer::setOffset(LPD8806VDOffset o)
+{
+  if (o != offset)
+    moved = true;
+  offset = o;
+}
+
+
+void LPD8806VDLayer::setOpacity(uint8_t a)
+{
+  if (a != opacity)
+    moved = true;
+  opacity = a;
+}
+
+
+void LPD8806VDLayer::setBlend(uint8_t mode)
+{
+  if (mode != blend)
+    moved = true;
+  blend = mode;
+}
+
+
+void LPD8806VDLayer::setZ(uint8_t order)
+{
+  if (order != z)
+    moved = true;
+  z = order;
+}
+
+
+void LPD8806VDLayer::setVisible(boolean on)
+{
+  if (on != visible)
+    moved = true;
+  visible = on;
+}
+
+
+// Pixels first..end-1 changed (widens the dirty range).
+void LPD8806VDLayer::changed(LPD8806VDIndex first, LPD8806VDIndex end)
+{
+  if (dirtyEnd == dirtyFirst)
+  {
+    dirtyFirst = first;
+    dirtyEnd   = end;
+    return;
+  }
+
+  if (first < dirtyFirst)
+    dirtyFirst = first;
+  if (end > dirtyEnd)
+    dirtyEnd = end;
+}
+
+
+/*****************************************************************************/
+
+LPD8806VDCompositor::LPD8806VDCompositor(LPD8806VD &s)
+{
+  strip  = &s;
+  layers = NULL;
+  spans  = 0;
+  added  = 0;
+}
+
+
+// Add a layer, above any with the same or lower z.
+void LPD8806VDCompositor::add(LPD8806VDLayer &layer)
+{
+  LPD8806VDLayer **pp;
+
+  for (pp = &layers; *pp != NULL; pp = &(*pp)->next)
+    if (*pp == &layer)
+      return;                               // Already added
+
+  layer.next  = NULL;
+  layer.shown = false;
+  layer.moved = true;
+  layer.added = added++;
+  *pp = &layer;
+  sortLayers();
+}
+
+
+void LPD8806VDCompositor::remove(LPD8806VDLayer &layer)
+{
+  LPD8806VDLayer **pp;
+
+  for (pp = &layers; *pp != NULL; pp = &(*pp)->next)
+  {
+    if (*pp == &layer)
+    {
+      *pp = layer.next;
+      layer.next = NULL;
+      if (layer.shown)
+        addSpan(layer.shownOffset, (int32_t)layer.shownOffset + layer.length);
+      layer.shown = false;
+      return;
+    }
+  }
+}
+
+
+void LPD8806VDCompositor::setDirty(void)
+{
+  LPD8806VDLayer *l;
+
+  for (l = layers; l != NULL; l = l->next)
+    l->moved = true;
+}
+
+
+// Collect the spans that changed since the last compose(), and redraw
+// them.  A layer that moved (or changed opacity, blend mode, z or
+// visibility) needs both where it was and where it is now redrawn;
+// otherwise, just the pixels that were set.
+void LPD8806VDCompositor::compose(void)
+{
+  LPD8806VDLayer *l;
+  boolean resort = false;
+  uint8_t i;
+
+  for (l = layers; l != NULL; l = l->next)
+  {
+    if (l->moved)
+    {
+      if (l->shown)
+        addSpan(l->shownOffset, (int32_t)l->shownOffset + l->length);
+      if (l->visible)
+        addSpan(l->offset, (int32_t)l->offset + l->length);
+      resort = true;
+    }
+    else if (l->visible && l->dirtyEnd > l->dirtyFirst)
+      addSpan((int32_t)l->offset + l->dirtyFirst, (int32_t)l->offset + l->dirtyEnd);
+
+    l->shown       = l->visible;
+    l->shownOffset = l->offset;
+    l->moved       = false;
+    l->dirtyFirst  = 0;
+    l->dirtyEnd    = 0;
+  }
+
+  if (resort)
+    sortLayers();
+
+  for (i = 0; i < spans; i++)
+    composeSpan(spanFirst[i], spanEnd[i]);
+  spans = 0;
+}
+
+
+void LPD8806VDCompositor::show(void)
+{
+  compose();
+  strip->show();
+}
+
+
+void LPD8806VDCompositor::showDirty(void)
+{
+  compose();
+  strip->showDirty();
+}
+
+
+// Note strip pixels first..end-1 for redrawing, merged with any span
+// they touch.  When all the span slots are taken, everything is merged
+// into one span.
+void LPD8806VDCompositor::addSpan(int32_t first, int32_t end)
+{
+  uint8_t i;
+
+  if (first < 0)
+    first = 0;
+  if (end > (int32_t)strip->numPixels())
+    end = strip->numPixels();
+  if (first >= end)
+    return;
+
+  for (i = 0; i < spans; )
+  {
+    if (first <= (int32_t)spanEnd[i] && end >= (int32_t)spanFirst[i])
+    {
+      if ((int32_t)spanFirst[i] < first)
+        first = spanFirst[i];
+      if ((int32_t)spanEnd[i] > end)
+        end = spanEnd[i];
+
+      // Drop span i (the merged one may now touch others: start over).
+      spans--;
+      spanFirst[i] = spanFirst[spans];
+      spanEnd[i]   = spanEnd[spans];
+      i = 0;
+    }
+    else
+      i++;
+  }
+
+  if (spans == LPD8806VD_MAX_SPANS)
+  {
+    for (i = 0; i < spans; i++)
+    {
+      if ((int32_t)spanFirst[i] < first)
+        first = spanFirst[i];
+      if ((int32_t)spanEnd[i] > end)
+        end = spanEnd[i];
+    }
+    spans = 0;
+  }
+
+  spanFirst[spans] = first;
+  spanEnd[spans]   = end;
+  spans++;
+}
+
+
+// Order the layers by z, bottom first, and by when they were added for
+// the same z (insertion sort).
+void LPD8806VDCompositor::sortLayers(void)
+{
+  LPD8806VDLayer *sorted = NULL;
+  LPD8806VDLayer *l, *rest, **pp;
+
+  for (l = layers; l != NULL; l = rest)
+  {
+    rest = l->next;
+    for (pp = &sorted; *pp != NULL && ((*pp)->z < l->z || ((*pp)->z == l->z && (*pp)->added < l->added));
+         pp = &(*pp)->next);
+    l->next = *pp;
+    *pp = l;
+  }
+
+  layers = sorted;
+}
+
+
+// Blend len bytes of layer s onto d (both 7 bit), with weight a = 0..256.
+// One loop per mode -- no per-byte switching.
+static void blendRun(uint8_t *d, const uint8_t *s, LPD8806VDIndex len, uint8_t mode, uint16_t a)
+{
+  uint16_t t = 256 - a;
+  uint8_t  m;
+
+  switch (mode)
+  {
+    case LPD8806VD_BLEND_ADD:
+      for (; len; len--, d++, s++)
+      {
+        m  = *d + (*s & 0x7f);
+        m  = (m > 127) ? 127 : m;
+        *d = (*d * t + m * a) >> 8;
+      }
+      break;
+    case LPD8806VD_BLEND_MULTIPLY:
+      for (; len; len--, d++, s++)
+      {
+        m  = (*d * ((*s & 0x7f) + 1)) >> 7;
+        *d = (*d * t + m * a) >> 8;
+      }
+      break;
+    case LPD8806VD_BLEND_LIGHTEN:
+      for (; len; len--, d++, s++)
+      {
+        m  = (*d > (*s & 0x7f)) ? *d : (*s & 0x7f);
+        *d = (*d * t + m * a) >> 8;
+      }
+      break;
+    default:
+      for (; len; len--, d++, s++)
+        *d = (*d * t + (*s & 0x7f) * a) >> 8;
+      break;
+  }
+}
+
+
+// Pack count 7 bit GRB pixels as colors for a strip of color depth Depth.
+template<uint8_t Depth> static void packRun(const uint8_t *p, uint32_t *colors, LPD8806VDIndex count)
+{
+  for (; count; count--, p += 3)
+    *colors++ = LPD8806VDCodec<Depth>::Color(p[1] << 1, p[0] << 1, p[2] << 1);
+}
+
+
+// Redraw strip pixels first..end-1: black, then every visible layer
+// over them, bottom up, a chunk at a time.  Each chunk goes into the
+// strip with one setPixels() call.
+void LPD8806VDCompositor::composeSpan(LPD8806VDIndex first, LPD8806VDIndex end)
+{
+  uint8_t  buf[LPD8806VD_COMPOSE_CHUNK * 3];
+  uint32_t colors[LPD8806VD_COMPOSE_CHUNK];
+  LPD8806VDLayer *l;
+  LPD8806VDIndex i, j, count;
+  int32_t lf, le;
+
+  for (i = first; i < end; i += count)
+  {
+    count = end - i;
+    if (count > LPD8806VD_COMPOSE_CHUNK)
+      count = LPD8806VD_COMPOSE_CHUNK;
+    memset(buf, 0, count * 3);
+
+    for (l = layers; l != NULL; l = l->next)
+    {
+      if (!l->visible)
+        continue;
+
+      // Part of the layer in this chunk
+      lf = l->offset;
+      le = lf + (int32_t)l->length;
+      if (lf < (int32_t)i)
+        lf = i;
+      if (le > (int32_t)(i + count))
+        le = i + count;
+      if (lf >= le)
+        continue;
+
+      blendRun(&buf[(lf - i) * 3], &l->pixels[(lf - l->offset) * 3], (le - lf) * 3,
+               l->blend, l->opacity + (l->opacity >> 7));
+    }
+
+    if (strip->getPaletteBits())
+    {
+      for (j = 0; j < count; j++)
+        colors[j] = strip->Color(buf[j * 3 + 1] << 1, buf[j * 3] << 1, buf[j * 3 + 2] << 1);
+    }
+    else
+    {
+      switch (strip->getColorDepth())
+      {
+        case 1:
+          packRun<1>(buf, colors, count);
+          break;
+        case 2:
+          packRun<2>(buf, colors, count);
+          break;
+        case 3:
+          packRun<3>(buf, colors, count);
+          break;
+      }
+    }
+
+    strip->setPixels(i, colors, count);
+  }
+}
@@ -0,0 +1,122 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Layers (sprites) composited onto a LPD8806VD strip.
+|| |
+|| | A layer is a short run of pixels in its own buffer (7 bit GRB, 3
+|| | bytes per pixel), placed at an offset along the strip, with an
+|| | opacity, a blend mode and a z order (higher is on top).  The
+|| | compositor tracks the range of each layer that changed, and where
+|| | layers moved, and before each show only redraws those spans: from
+|| | black, each layer over them in z order, then into the strip's pixels
+|| | with setPixels(), a chunk at a time.  So compositing costs about the
+|| | size of what changed, not the strip length times the number of
+|| | layers.
+|| |
+|| | The compositor owns every pixel under a layer (or where one was);
+|| | pixels no layer has touched are left alone.
+|| |
+|| |   uint8_t bgBuf[160 * 3], cursorBuf[3 * 3];
+|| |   LPD8806VDLayer bg(bgBuf, 160), cursor(cursorBuf, 3, 40, 1);
+|| |   LPD8806VDCompositor comp(strip);
+|| |   comp.add(bg);
+|| |   comp.add(cursor);
+|| |   cursor.setBlend(LPD8806VD_BLEND_ADD);
+|| |   ...
+|| |   cursor.setOffset(41);
+|| |   comp.show();                           // Redraws pixels 40..43
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#ifndef LPD8806VDLAYER_H
+#define LPD8806VDLAYER_H
+
+#include "LPD8806VD.h"
+
+// Blend modes (see LPD8806VDLayer::setBlend())
+#define LPD8806VD_BLEND_NORMAL   0                // Layer over what's below
+#define LPD8806VD_BLEND_ADD      1                // Sum of both, clipped
+#define LPD8806VD_BLEND_MULTIPLY 2                // Product of both (darkens)
+#define LPD8806VD_BLEND_LIGHTEN  3                // Brighter of the two, per channel
+
+// Changed spans tracked between shows; past this, they are merged.
+#define LPD8806VD_MAX_SPANS 8
+
+class LPD8806VDLayer
+{
+  friend class LPD8806VDCompositor;
+
+  public:
+    LPD8806VDLayer(uint8_t *buf, LPD8806VDIndex n, LPD8806VDOffset offset = 0, uint8_t z = 0);
+
+    void clear(void);                             // All black
+    void setPixelColor(LPD8806VDIndex n, uint8_t r, uint8_t g, uint8_t b);
+    void setPixelColor(LPD8806VDIndex n, uint32_t c);  // c is 24 bit RGB
+    uint32_t getPixelColor(LPD8806VDIndex n);     // 24 bit RGB
+    void setDirty(void);                          // Buffer written directly: redraw it all
+
+    void setOffset(LPD8806VDOffset offset);       // First strip pixel covered (may be < 0)
+    LPD8806VDOffset getOffset(void) { return offset; };
+    void setOpacity(uint8_t a);                   // 0 = invisible, 255 = full strength
+    uint8_t getOpacity(void) { return opacity; };
+    void setBlend(uint8_t mode);                  // LPD8806VD_BLEND_...
+    uint8_t getBlend(void) { return blend; };
+    void setZ(uint8_t z);                         // Higher z is drawn later (on top)
+    uint8_t getZ(void) { return z; };
+    void setVisible(boolean on);
+    boolean isVisible(void) { return visible; };
+    LPD8806VDIndex numPixels(void) { return length; };
+
+  private:
+    uint8_t *pixels;                              // 7 bit G, R, B per pixel
+    LPD8806VDIndex length;
+    LPD8806VDOffset offset;
+    LPD8806VDOffset shownOffset;                  // Where it was last composited
+    boolean shown;                                // If 'true', it is on the strip at shownOffset
+    uint8_t opacity;
+    uint8_t blend;
+    uint8_t z;
+    uint16_t added;                               // When added (same z: later is on top)
+    boolean visible;
+    boolean moved;                                // If 'true', redraw where it was and where it is
+    LPD8806VDIndex dirtyFirst, dirtyEnd;          // Pixels changed since last composited
+    LPD8806VDLayer *next;                         // Next layer up
+
+    void changed(LPD8806VDIndex first, LPD8806VDIndex end);
+};
+
+
+class LPD8806VDCompositor
+{
+  public:
+    LPD8806VDCompositor(LPD8806VD &strip);
+
+    void add(LPD8806VDLayer &layer);
+    void remove(LPD8806VDLayer &layer);           // Its pixels are redrawn without it
+    void setDirty(void);                          // Redraw under every layer (e.g. after strip.clear())
+
+    void compose(void);                           // Redraw the spans that changed
+    void show(void);                              // compose(), then show the strip
+    void showDirty(void);                         // compose(), then showDirty()
+
+  private:
+    LPD8806VD *strip;
+    LPD8806VDLayer *layers;                       // Bottom layer first
+    LPD8806VDIndex spanFirst[LPD8806VD_MAX_SPANS];
+    LPD8806VDIndex spanEnd[LPD8806VD_MAX_SPANS];
+    uint8_t spans;
+    uint16_t added;                               // Layers added so far
+
+    void addSpan(int32_t first, int32_t end);
+    void sortLayers(void);
+    void composeSpan(LPD8806VDIndex first, LPD8806VDIndex end);
+};
+
+#endif
@@ -0,0 +1,310 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Drives several LPD8806VD strips at once, bit-sliced.
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#include "LPD8806VDMulti.h"
+
+#if !defined(LPD8806VD_HOST)
+
+// Pixels encoded per lane per pass.  Costs 24 bytes of stack per pixel.
+#define LPD8806VD_MULTI_CHUNK 4
+
+/*****************************************************************************/
+
+LPD8806VDMulti::LPD8806VDMulti(uint8_t cpin)
+{
+  uint8_t i;
+
+  for (i = 0; i < LPD8806VD_MAX_LANES; i++)
+    lane[i] = NULL;
+  lanes      = 0;
+  numLEDs    = 0;
+  clkpin     = cpin;
+
+#if defined(LPD8806VD_FAST_PINS)
+  dataport   = 0;
+  datamask   = 0;
+  laneShift  = 0;
+  clkport    = LPD8806VD_PORT(cpin);
+  clkpinmask = LPD8806VD_MASK(cpin);
+#endif
+}
+
+
+// Add a strip, with its data pin ('false' if the pin has no port bit).
+// With port access, the strip's lane is the pin's bit in the port, so all
+// data pins must be on the same port (and not share the clock pin's bit).
+// On 32 bit ports, they must also be in the same byte of the port
+// (e.g. bits 8-15).
+boolean LPD8806VDMulti::addStrip(LPD8806VD &strip, uint8_t dpin)
+{
+  uint8_t l = lanes;
+
+  if (lanes >= LPD8806VD_MAX_LANES)
+    return false;
+
+#if defined(LPD8806VD_FAST_PINS)
+  LPD8806VDPortReg *port = LPD8806VD_PORT(dpin);
+  LPD8806VDPortMask mask = LPD8806VD_MASK(dpin);
+  uint8_t bit;
+
+  if (mask == 0)
+    return false;                           // Not a digital pin
+
+  for (bit = 0; !(mask & ((LPD8806VDPortMask)1 << bit)); bit++);
+
+  if ((dataport != 0 && (port != dataport || (bit & ~7) != laneShift)) ||
+      (datamask & mask) || (port == clkport && mask == clkpinmask))
+    return false;
+
+  dataport  = port;
+  datamask |= mask;
+  laneShift = bit & ~7;
+  l         = bit & 7;
+#endif
+
+  lane[l]         = &strip;
+  datapin[l]      = dpin;
+  order[lanes++]  = l;
+  numLEDs        += strip.numPixels();
+
+  return true;
+}
+
+
+// Enable the pins and issue initial latch.
+void LPD8806VDMulti::begin(void)
+{
+  uint8_t  i;
+  LPD8806VDIndex longest = 0;
+  uint8_t  zeros[8] = { 0 };
+
+  pinMode(clkpin, OUTPUT);
+  for (i = 0; i < lanes; i++)
+  {
+    pinMode(datapin[order[i]], OUTPUT);
+    if (lane[order[i]]->numPixels() > longest)
+      longest = lane[order[i]]->numPixels();
+  }
+
+  for (i = (longest + 31) / 32; i; i--)
+    sendPlanes(zeros);
+}
+
+
+void LPD8806VDMulti::clear(void)
+{
+  uint8_t i;
+
+  for (i = 0; i < lanes; i++)
+    lane[order[i]]->clear();
+}
+
+
+// Strip holding pixel n; n becomes the pixel number within that strip.
+LPD8806VD *LPD8806VDMulti::locate(LPD8806VDIndex &n)
+{
+  uint8_t i;
+  LPD8806VD *strip;
+
+  for (i = 0; i < lanes; i++)
+  {
+    strip = lane[order[i]];
+    if (n < strip->numPixels())
+      return strip;
+    n -= strip->numPixels();
+  }
+
+  return NULL;
+}
+
+
+void LPD8806VDMulti::setPixelColor(LPD8806VDIndex n, uint8_t r, uint8_t g, uint8_t b)
+{
+  LPD8806VD *strip = locate(n);
+
+  if (strip != NULL)
+    strip->setPixelColor(n, r, g, b);
+}
+
+
+void LPD8806VDMulti::setPixelColor(LPD8806VDIndex n, uint32_t c)
+{
+  LPD8806VD *strip = locate(n);
+
+  if (strip != NULL)
+    strip->setPixelColor(n, c);
+}
+
+
+uint32_t LPD8806VDMulti::getPixelColor(LPD8806VDIndex n)
+{
+  LPD8806VD *strip = locate(n);
+
+  if (strip != NULL)
+    return strip->getPixelColor(n);
+  return 0;
+}
+
+
+// Transpose 8 bytes (a bit matrix): out[k] bit l = in[7 - l] bit (7 - k).
+// (Hacker's Delight, transpose8)
+static void transpose8(const uint8_t *in, uint8_t *out)
+{
+  uint32_t x, y, t;
+
+  x = ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+  y = ((uint32_t)in[4] << 24) | ((uint32_t)in[5] << 16) | ((uint32_t)in[6] << 8) | in[7];
+
+  t = (x ^ (x >> 7)) & 0x00AA00AA;  x = x ^ t ^ (t << 7);
+  t = (y ^ (y >> 7)) & 0x00AA00AA;  y = y ^ t ^ (t << 7);
+
+  t = (x ^ (x >> 14)) & 0x0000CCCC; x = x ^ t ^ (t << 14);
+  t = (y ^ (y >> 14)) & 0x0000CCCC; y = y ^ t ^ (t << 14);
+
+  t = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+  y = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+  x = t;
+
+  out[0] = x >> 24; out[1] = x >> 16; out[2] = x >> 8; out[3] = x;
+  out[4] = y >> 24; out[5] = y >> 16; out[6] = y >> 8; out[7] = y;
+}
+
+
+// Clock out one byte on every lane: planes[k] holds bit (7 - k) of each
+// lane's byte, at the lane's bit.
+void LPD8806VDMulti::sendPlanes(const uint8_t *planes)
+{
+  uint8_t k, l;
+
+#if defined(LPD8806VD_FAST_PINS)
+  if (dataport != 0)
+  {
+    // One port write per bit for all lanes.
+    // (Other pins on the data and clock ports keep the state they had
+    // here.)
+    LPD8806VDPortReg *port = dataport;
+    LPD8806VDPortReg *cport = clkport;
+    LPD8806VDPortMask keep, d, chi, clo;
+
+    keep = *port & ~datamask;
+    if (cport == port)
+    {
+      keep &= ~clkpinmask;
+      for (k = 0; k < 8; k++)
+      {
+        d = keep | (((LPD8806VDPortMask)planes[k] << laneShift) & datamask);
+        *port = d;
+        *port = d | clkpinmask;
+        *port = d;
+      }
+    }
+    else
+    {
+      clo = *cport & ~clkpinmask;
+      chi = clo | clkpinmask;
+      for (k = 0; k < 8; k++)
+      {
+        *port  = keep | (((LPD8806VDPortMask)planes[k] << laneShift) & datamask);
+        *cport = chi;
+        *cport = clo;
+      }
+    }
+    return;
+  }
+#endif
+
+  // can't do low level bitbanging, revert to digitalWrite
+  for (k = 0; k < 8; k++)
+  {
+    for (l = 0; l < LPD8806VD_MAX_LANES; l++)
+      if (lane[l] != NULL)
+        digitalWrite(datapin[l], (planes[k] >> l) & 1);
+    digitalWrite(clkpin, HIGH);
+    digitalWrite(clkpin, LOW);
+  }
+}
+
+
+// Show all strips at once (dithered, for strips with dithering on).
+// Shorter strips get zeros past their end, which only add to their latch.
+void LPD8806VDMulti::show(void)
+{
+  uint8_t  buf[LPD8806VD_MAX_LANES][LPD8806VD_MULTI_CHUNK * 3];
+  uint8_t  bytes[8];
+  uint8_t  planes[8];
+  LPD8806VDIndex longest = 0;
+  LPD8806VDIndex i, count, len, j;
+  uint8_t  l;
+  LPD8806VD *strip;
+
+  for (l = 0; l < LPD8806VD_MAX_LANES; l++)
+  {
+    if (lane[l] != NULL)
+    {
+      lane[l]->waitShow();
+      if (lane[l]->dither != LPD8806VD_DITHER_OFF)
+        lane[l]->ditherFrame++;
+      if (lane[l]->numPixels() > longest)
+        longest = lane[l]->numPixels();
+    }
+  }
+
+  for (i = 0; i < longest; i += count)
+  {
+    count = longest - i;
+    if (count > LPD8806VD_MULTI_CHUNK)
+      count = LPD8806VD_MULTI_CHUNK;
+
+    // Encode a chunk of each strip
+    for (l = 0; l < LPD8806VD_MAX_LANES; l++)
+    {
+      strip = lane[l];
+      if (strip == NULL)
+        continue;
+      memset(buf[l], 0, count * 3);
+      if (i < strip->numLEDs)
+      {
+        len = strip->numLEDs - i;
+        if (len > count)
+          len = count;
+        if (strip->dither != LPD8806VD_DITHER_OFF)
+          strip->encodeDither(i, len, buf[l]);
+        else if (strip->wire != NULL && !strip->wireStale)
+          memcpy(buf[l], &strip->wire[i * 3], len * 3);
+        else
+          strip->encodePixels(i, len, buf[l]);
+      }
+    }
+
+    // Then send it out, a byte from every strip at a time
+    for (j = 0; j < count * 3; j++)
+    {
+      for (l = 0; l < 8; l++)
+        bytes[7 - l] = (l < LPD8806VD_MAX_LANES && lane[l] != NULL) ? buf[l][j] : 0;
+      transpose8(bytes, planes);
+      sendPlanes(planes);
+    }
+  }
+
+  // Now send "latch" clear bytes (0)
+  memset(planes, 0, sizeof(planes));
+  for (i = (longest + 31) / 32; i; i--)
+    sendPlanes(planes);
+
+  for (l = 0; l < LPD8806VD_MAX_LANES; l++)
+    if (lane[l] != NULL)
+      lane[l]->dirtyEnd = 0;
+}
+
+#endif // !LPD8806VD_HOST
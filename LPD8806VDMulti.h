@@ -0,0 +1,74 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Drives up to 8 LPD8806VD strips at once, bit-bang'd, with a shared
+|| | clock pin.  The data pins should all be on the same port: each clock
+|| | then takes a single port write carrying one bit for every strip, so
+|| | N strips show in about the time of one.
+|| |
+|| | The strips keep their own pixel buffers, color depths, palettes, etc.
+|| | (their own pins/transports are not used).  They are also presented
+|| | as one long strip: pixel 0 is the first pixel of the first strip
+|| | added, and so on.
+|| |
+|| | e.g.
+|| |   LPD8806VD strip1(60, buf1, 2), strip2(60, buf2, 2);
+|| |   LPD8806VDMulti multi(13);        // clock pin
+|| |   multi.addStrip(strip1, 2);        // data pins
+|| |   multi.addStrip(strip2, 3);
+|| |   multi.begin();
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#ifndef LPD8806VDMULTI_H
+#define LPD8806VDMULTI_H
+
+#include "LPD8806VD.h"
+
+#if !defined(LPD8806VD_HOST)
+
+#define LPD8806VD_MAX_LANES 8
+
+class LPD8806VDMulti
+{
+  public:
+    LPD8806VDMulti(uint8_t cpin);
+
+    boolean addStrip(LPD8806VD &strip, uint8_t dpin);  // 'false' if full, or pin on another port
+
+    void begin(void);
+    void clear(void);
+    void show(void);
+
+    LPD8806VDIndex numPixels(void) { return numLEDs; };
+    void setPixelColor(LPD8806VDIndex n, uint8_t r, uint8_t g, uint8_t b);
+    void setPixelColor(LPD8806VDIndex n, uint32_t c);   // c is packed for that pixel's strip
+    uint32_t getPixelColor(LPD8806VDIndex n);
+
+  private:
+    LPD8806VD *lane[LPD8806VD_MAX_LANES];         // Strips, by lane (port bit when fast)
+    uint8_t datapin[LPD8806VD_MAX_LANES];         // Data pins, by lane
+    uint8_t order[LPD8806VD_MAX_LANES];           // Lanes, in the order added
+    uint8_t lanes;                                // Number of strips
+    LPD8806VDIndex numLEDs;                       // Total pixels
+    uint8_t clkpin;
+#if defined(LPD8806VD_FAST_PINS)
+    LPD8806VDPortMask clkpinmask, datamask;       // Clock & all data PORT bitmasks
+    LPD8806VDPortReg *clkport, *dataport;         // Clock & data PORT registers
+    uint8_t laneShift;                            // Port bit of lane 0
+#endif
+
+    LPD8806VD *locate(LPD8806VDIndex &n);
+    void sendPlanes(const uint8_t *planes);
+};
+
+#endif // !LPD8806VD_HOST
+
+#endif
@@ -0,0 +1,279 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Multi-threaded frame encoding for LPD8806VD.
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#include "LPD8806VDParallel.h"
+
+#if defined(LPD8806VD_THREADS)
+
+#if defined(LPD8806VD_STATS)
+ #include <chrono>
+ // Microseconds, callable from any thread
+ static uint32_t statMicros(void)
+ {
+   return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+ }
+ #define LPD8806VD_STAT(x) x
+#else
+ #define LPD8806VD_STAT(x)
+#endif
+
+/*****************************************************************************/
+
+LPD8806VDParallel::LPD8806VDParallel(LPD8806VD &s, uint8_t threads, LPD8806VDIndex seg)
+{
+  unsigned cores;
+  uint8_t  i;
+
+  strip    = &s;
+  segment  = seg ? seg : 1;
+  segments = 0;
+  next     = 0;
+  busy     = 0;
+  frame    = 0;
+  quit     = false;
+  out      = NULL;
+  fill     = NULL;
+  shader   = NULL;
+  ctx      = NULL;
+  LPD8806VD_STAT(encodeMicros = 0);
+
+  // The calling thread encodes too, so one worker per extra core.
+  if (threads == 0)
+  {
+    cores   = std::thread::hardware_concurrency();
+    threads = (cores > 255) ? 255 : (cores > 1) ? cores - 1 : 0;
+  }
+
+  for (i = 0; i < threads; i++)
+    workers.push_back(std::thread(&LPD8806VDParallel::run, this, i));
+}
+
+
+LPD8806VDParallel::~LPD8806VDParallel()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    quit = true;
+  }
+  wake.notify_all();
+
+  for (size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+}
+
+
+// Show the pixel buffer.  With a wire buffer that is up to date, there
+// is nothing to encode; if it is stale, it is re-encoded in parallel.
+void LPD8806VDParallel::show(void)
+{
+  strip->waitShow();
+
+  if (strip->dither != LPD8806VD_DITHER_OFF || strip->pixels == NULL ||
+      (strip->wire != NULL && !strip->wireStale))
+  {
+    strip->show();
+    return;
+  }
+
+  if (strip->wire != NULL)
+  {
+    out = strip->wire;
+    strip->wireStale = false;
+  }
+  else
+  {
+    frameBuf.resize(strip->numLEDs * 3);
+    out = frameBuf.data();
+  }
+
+  fill   = NULL;
+  shader = NULL;
+  sendFrame();
+  strip->dirtyEnd = 0;
+}
+
+
+// Show pixels from fill(first, count, buf, ctx), called for each segment
+// (count is at most the segment size), from any thread.
+void LPD8806VDParallel::showStream(LPD8806VDFill f, void *c)
+{
+  strip->waitShow();
+
+  frameBuf.resize(strip->numLEDs * 3);
+  scratch.resize((workers.size() + 1) * segment * 3);
+  out    = frameBuf.data();
+  fill   = f;
+  shader = NULL;
+  ctx    = c;
+  sendFrame();
+  fill   = NULL;
+
+  if (strip->pixels != NULL)
+    strip->setDirty(strip->numLEDs);
+}
+
+
+// Show pixels from shader(n, ctx) (7 bit GRB), called from any thread.
+void LPD8806VDParallel::showShader(LPD8806VDShader s, void *c)
+{
+  strip->waitShow();
+
+  frameBuf.resize(strip->numLEDs * 3);
+  out    = frameBuf.data();
+  fill   = NULL;
+  shader = s;
+  ctx    = c;
+  sendFrame();
+  shader = NULL;
+
+  if (strip->pixels != NULL)
+    strip->setDirty(strip->numLEDs);
+}
+
+
+// Start the workers on a frame, then send its segments in order (and
+// encode segments while the next one to send isn't ready), then the latch.
+void LPD8806VDParallel::sendFrame(void)
+{
+  LPD8806VDIndex n = strip->numLEDs;
+  LPD8806VDIndex s, first, count;
+  uint8_t self = workers.size();
+
+  segments = (n + segment - 1) / segment;
+  if (ready.size() < segments)
+  {
+    std::vector< std::atomic<uint32_t> > more(segments);
+    ready.swap(more);
+    for (s = 0; s < segments; s++)
+      ready[s] = 0;
+  }
+
+  next = 0;
+  LPD8806VD_STAT(encodeMicros = 0);
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (++frame == 0)                           // Wrapped: forget old frames
+    {
+      for (s = 0; s < ready.size(); s++)
+        ready[s] = 0;
+      frame = 1;
+    }
+    busy = workers.size();
+  }
+  wake.notify_all();
+
+  for (s = 0; s < segments; s++)
+  {
+    while (ready[s].load(std::memory_order_acquire) != frame)
+      if (!encodeNext(self))
+        std::this_thread::yield();
+
+    first = s * segment;
+    count = (n - first < segment) ? n - first : segment;
+    strip->sendBytes(out + first * 3, count * 3);
+  }
+
+  // Now send "latch" clear bytes (0)
+  strip->sendZeros(strip->latchBytes);
+
+  // Workers may still be between their last segment and going idle.
+  while (busy)
+    std::this_thread::yield();
+
+#if defined(LPD8806VD_STATS)
+  strip->stats.encodeMicros += encodeMicros;
+  strip->statsFrame();
+#endif
+}
+
+
+// Worker thread: wait for a frame, encode segments until none are left.
+void LPD8806VDParallel::run(uint8_t id)
+{
+  uint32_t seen = 0;
+
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      while (!quit && frame == seen)
+        wake.wait(guard);
+      if (quit)
+        return;
+      seen = frame;
+    }
+
+    while (encodeNext(id));
+    busy--;
+  }
+}
+
+
+// Claim the next segment and encode it.  Returns 'false' if there are
+// none left.
+boolean LPD8806VDParallel::encodeNext(uint8_t id)
+{
+  LPD8806VDIndex s = next++;
+
+  if (s >= segments)
+    return false;
+
+  encodeSegment(s, id);
+  ready[s].store(frame, std::memory_order_release);
+  return true;
+}
+
+
+// Render (fill() or shader(), if set) and encode segment s into out.
+// id picks the thread's scratch buffer.
+void LPD8806VDParallel::encodeSegment(LPD8806VDIndex s, uint8_t id)
+{
+  LPD8806VDIndex first = s * segment;
+  LPD8806VDIndex count = strip->numLEDs - first;
+  LPD8806VDIndex j;
+  uint8_t  *dst = out + first * 3;
+  uint8_t  *buf;
+  uint32_t c;
+  LPD8806VD_STAT(uint32_t t = statMicros());
+
+  if (count > segment)
+    count = segment;
+
+  if (shader != NULL)
+  {
+    for (j = 0, buf = dst; j < count; j++, buf += 3)
+    {
+      c = shader(first + j, ctx);
+      buf[0] = (c >> 16) | 0x80;
+      buf[1] = (c >> 8) | 0x80;
+      buf[2] = c | 0x80;
+    }
+  }
+  else if (fill != NULL)
+  {
+    buf = &scratch[id * segment * 3];
+    fill(first, count, buf, ctx);
+    strip->encodeRun(buf, 0, count, dst);
+  }
+  else if (strip->paletteBits == 4)
+    strip->encodeRun(&strip->pixels[first >> 1], first & 1, count, dst);
+  else
+    strip->encodeRun(&strip->pixels[first * strip->colorDepth], 0, count, dst);
+
+  strip->applyLevels(dst, count * 3);
+  LPD8806VD_STAT(encodeMicros += statMicros() - t);
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Multi-threaded show() for long strips on multicore hosts (host
+|| | builds, and ESP32 -- anywhere with std::thread).
+|| |
+|| | The strip is split into segments.  Worker threads claim segments
+|| | (an atomic counter) and render/encode them into a frame buffer,
+|| | flagging each one ready as it is done.  The calling thread sends the
+|| | segments in order as soon as each one is ready, so segment 0 goes out
+|| | while the rest are still being encoded; while it waits, it encodes
+|| | segments too.  No locks are taken during a frame.
+|| |
+|| |   LPD8806VDParallel par(strip);          // 1 thread per extra core
+|| |   par.show();                            // Same bytes as strip.show()
+|| |   par.showShader(fn, ctx);               // fn() is called from many threads
+|| |
+|| | Pays off when encoding (or rendering) is slower than the bus, e.g.
+|| | thousands of pixels with gamma/brightness, a palette or a shader.
+|| | Dithering carries state along the strip, so with dithering on, show()
+|| | is the strip's own (single threaded) show().
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#ifndef LPD8806VDPARALLEL_H
+#define LPD8806VDPARALLEL_H
+
+#include "LPD8806VD.h"
+
+#if defined(LPD8806VD_HOST) || defined(ESP32)
+ #define LPD8806VD_THREADS
+#endif
+
+#if defined(LPD8806VD_THREADS)
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class LPD8806VDParallel
+{
+  public:
+    LPD8806VDParallel(LPD8806VD &strip, uint8_t threads = 0, LPD8806VDIndex segment = 512);  // threads: 0 = 1 per extra core
+    ~LPD8806VDParallel();
+
+    void show(void);                              // Show all pixels
+    void showStream(LPD8806VDFill fill, void *ctx = NULL);  // As LPD8806VD::showStream(); fill() must be thread safe
+    void showShader(LPD8806VDShader shader, void *ctx = NULL);  // As LPD8806VD::showShader(), no mix; shader() must be thread safe
+
+    uint8_t getThreads(void) { return workers.size(); };  // Worker threads (besides the caller)
+
+  private:
+    LPD8806VD *strip;
+    LPD8806VDIndex segment;                       // Pixels per segment
+    LPD8806VDIndex segments;                      // Segments in this frame
+    std::vector<std::thread> workers;
+    std::vector<uint8_t> frameBuf;                // Encoded frame (no wire buffer)
+    std::vector<uint8_t> scratch;                 // Packed pixels for fill(), per thread
+    std::vector< std::atomic<uint32_t> > ready;   // Frame number each segment was done for
+    std::atomic<uint32_t> next;                   // Next segment to claim
+    std::atomic<uint8_t> busy;                    // Workers still in this frame
+    std::mutex lock;                              // Only for waking the workers
+    std::condition_variable wake;
+    uint32_t frame;                               // Frame number (never 0)
+#if defined(LPD8806VD_STATS)
+    std::atomic<uint32_t> encodeMicros;           // Encoding time this frame, all threads
+#endif
+    boolean quit;
+
+    uint8_t *out;                                 // Where this frame is encoded
+    LPD8806VDFill fill;                           // Frame source: fill(), shader(), or
+    LPD8806VDShader shader;                       // the pixel buffer
+    void *ctx;
+
+    void run(uint8_t id);
+    boolean encodeNext(uint8_t id);
+    void encodeSegment(LPD8806VDIndex s, uint8_t id);
+    void sendFrame(void);
+};
+
+#endif
+
+#endif
@@ -0,0 +1,125 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Fixed frame rate show() scheduling for LPD8806VD.
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#include "LPD8806VDScheduler.h"
+
+#if defined(LPD8806VD_HOST)
+#include <chrono>
+#endif
+
+/*****************************************************************************/
+
+LPD8806VDScheduler::LPD8806VDScheduler(LPD8806VD &s, uint16_t rate)
+{
+  strip = &s;
+  setFrameRate(rate);
+  resetStats();
+}
+
+
+// Change the frame rate.  The first frame slot starts at the next update().
+void LPD8806VDScheduler::setFrameRate(uint16_t rate)
+{
+  fps      = rate;
+  interval = rate ? 1000000UL / rate : 0;
+  started  = false;
+}
+
+
+void LPD8806VDScheduler::resetStats(void)
+{
+  frames  = 0;
+  skipped = 0;
+  dropped = 0;
+  late    = 0;
+}
+
+
+uint32_t LPD8806VDScheduler::now(void)
+{
+#if defined(LPD8806VD_HOST)
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+  return micros();
+#endif
+}
+
+
+// Show the strip if its frame slot has come up and any pixels changed.
+// Slots stay on a fixed grid (no drift when update() is called a bit
+// late); whole slots that went by without an update() are dropped.
+boolean LPD8806VDScheduler::update(void)
+{
+  uint32_t t = now();
+  uint32_t behind;
+
+  if (interval != 0)
+  {
+    if (!started)
+    {
+      next    = t;
+      started = true;
+    }
+
+    if ((int32_t)(t - next) < 0)
+      return false;                           // Not time yet
+
+    behind = t - next;
+    if (behind >= interval)
+    {
+      dropped += behind / interval;
+      behind  %= interval;
+      next     = t - behind;
+    }
+    next += interval;
+  }
+  else
+    behind = 0;
+
+  if (strip->isBusy())
+  {
+    dropped++;
+    return false;
+  }
+
+  if (!strip->isDirty())
+  {
+    skipped++;
+    return false;
+  }
+
+  if (behind > interval / 2)
+    late++;
+
+  strip->showAsync();
+  frames++;
+  return true;
+}
+
+
+// Show the strip now if any pixels changed.  Meant to be called from a
+// timer interrupt at the frame rate (see LPD8806VDScheduler.h).
+void LPD8806VDScheduler::tick(void)
+{
+  if (strip->isBusy())
+    dropped++;
+  else if (!strip->isDirty())
+    skipped++;
+  else
+  {
+    strip->showAsync();
+    frames++;
+  }
+}
@@ -0,0 +1,60 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Shows a LPD8806VD strip at a fixed frame rate.
+|| | Frames are only sent when pixels have changed since the last one, and
+|| | frames that could not go out in their time slot are counted.
+|| |
+|| | Either call update() from loop() as often as you like:
+|| |   LPD8806VDScheduler sched(strip, 50);   // 50 fps
+|| |   void loop() { draw(); sched.update(); }
+|| |
+|| | or call tick() from a timer interrupt running at the frame rate.
+|| | Since the latch bytes go out at the end of each frame, the strip is
+|| | always ready and the payload starts right on the tick.  With
+|| | LPD8806VD_ASYNC and a wire buffer, tick() only starts a background
+|| | show; otherwise the whole frame is sent inside the interrupt.
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#ifndef LPD8806VDSCHEDULER_H
+#define LPD8806VDSCHEDULER_H
+
+#include "LPD8806VD.h"
+
+class LPD8806VDScheduler
+{
+  public:
+    LPD8806VDScheduler(LPD8806VD &strip, uint16_t fps = 60);
+
+    void setFrameRate(uint16_t fps);              // 0 = no limit, show whenever changed
+    uint16_t getFrameRate(void) { return fps; };
+
+    boolean update(void);                         // Show if a frame is due and changed; 'true' if shown
+    void tick(void);                              // Show if changed (from a timer interrupt)
+
+    uint32_t getFrames(void) { return frames; };  // Frames shown
+    uint32_t getSkipped(void) { return skipped; };  // Frame slots with nothing changed
+    uint32_t getDropped(void) { return dropped; };  // Frame slots missed (or bus still busy)
+    uint32_t getLate(void) { return late; };      // Frames shown more than half a slot late
+    void resetStats(void);
+
+  private:
+    LPD8806VD *strip;
+    uint16_t fps;
+    uint32_t interval;                            // Frame period, in microseconds
+    uint32_t next;                                // Start of the next frame slot (micros())
+    boolean started;                              // If 'true', next is set
+    volatile uint32_t frames, skipped, dropped, late;
+
+    uint32_t now(void);
+};
+
+#endif
@@ -0,0 +1,100 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Compile-time configured LPD8806 strip.
+|| | Color depth, strip length and transport are template parameters, so
+|| | the pixel buffer is part of the object and there is no switching on
+|| | depth or transport anywhere.  Use LPD8806VD when these need to
+|| | change at run time.
+|| |
+|| | e.g.
+|| |   LPD8806VDStrip<2, 160, LPD8806VDHardwareSPI> strip;
+|| |   LPD8806VDStrip<1, 64, LPD8806VDBitbang> strip2(LPD8806VDBitbang(2, 3));
+|| |
+|| | Needs C++11 (constexpr).
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#ifndef LPD8806VDSTRIP_H
+#define LPD8806VDSTRIP_H
+
+#include "LPD8806VD.h"
+
+template<uint8_t Depth, LPD8806VDIndex N, class Transport>
+class LPD8806VDStrip
+{
+  public:
+    typedef LPD8806VDCodec<Depth> Codec;
+
+    static constexpr LPD8806VDIndex numPixels(void) { return N; };
+    static constexpr uint8_t getColorDepth(void) { return Depth; };
+    static constexpr LPD8806VDIndex latchBytes(void) { return (N + 31) / 32; };  // 1 latch byte every 32 "pixels"
+
+    LPD8806VDStrip() { clear(); };
+    LPD8806VDStrip(const Transport &t) : transport(t) { clear(); };
+
+    // Activate the transport and issue initial latch.
+    void begin(void)
+    {
+      transport.begin();
+      transport.writeZeros(latchBytes());
+      transport.flush();
+    };
+
+    void clear(void) { memset(pixels, 0, sizeof(pixels)); };
+
+    // Push the pixels out to the strip, a chunk at a time.
+    void show(void)
+    {
+      uint8_t buf[Chunk * 3];
+      const uint8_t *ptr = pixels;
+      LPD8806VDIndex i, j;
+
+      for (i = 0; i + Chunk <= N; i += Chunk)
+      {
+        for (j = 0; j < Chunk; j++, ptr += Depth)
+          Codec::encode(ptr, &buf[j * 3]);
+        transport.write(buf, Chunk * 3);
+      }
+      for (j = 0; i < N; i++, j++, ptr += Depth)
+        Codec::encode(ptr, &buf[j * 3]);
+      if (j)
+        transport.write(buf, j * 3);
+
+      // Latch, and end the frame (send anything the transport held back)
+      transport.writeZeros(latchBytes());
+      transport.flush();
+    };
+
+    // Convert R,G,B / 24 bit RGB to a packed color
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) { return Codec::Color(r, g, b); };
+    static uint32_t Color(uint32_t color) { return Codec::Color(color >> 16, color >> 8, color); };
+
+    void setPixelColor(LPD8806VDIndex n, uint32_t c) { Codec::store(&pixels[n * Depth], c); };
+    void setPixelColor(LPD8806VDIndex n, uint8_t r, uint8_t g, uint8_t b) { setPixelColor(n, Color(r, g, b)); };
+
+    uint32_t getPixelColor(LPD8806VDIndex n)
+    {
+      if (n < N)
+        return Codec::getPixelColor(&pixels[n * Depth]);
+      return 0; // Pixel # is out of bounds
+    };
+
+    uint8_t *getPixels(void) { return pixels; };
+    Transport &getTransport(void) { return transport; };
+
+  private:
+    static constexpr LPD8806VDIndex Chunk = (N < 16) ? N : 16;  // Pixels encoded per write
+
+    uint8_t pixels[N * Depth];
+    Transport transport;
+};
+
+#endif
@@ -0,0 +1,583 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+|| @contribution   Adafruit Industries (LPD8806 Library and Example Code)
+||
+|| @description
+|| | Byte transports for LPD8806VD strips.
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#if !defined(WIRING) && !defined(ARDUINO)
+ // Host build: no SPI library
+#else
+ #include <SPI.h>
+#endif
+#include "LPD8806VDTransport.h"
+
+#if defined(LPD8806VD_HOST) && defined(__linux__)
+ #include <errno.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/ioctl.h>
+ #include <linux/spi/spidev.h>
+#endif
+
+/*****************************************************************************/
+
+// Send "latch" clear bytes (0), a chunk at a time.
+void LPD8806VDTransport::writeZeros(size_t len)
+{
+  static const uint8_t zeros[16] = { 0 };
+  size_t count;
+
+  while (len)
+  {
+    count = (len > sizeof(zeros)) ? sizeof(zeros) : len;
+    write(zeros, count);
+    len -= count;
+  }
+}
+
+
+// Find the fastest bit rate, from minHz up to maxHz (doubling each step),
+// at which a test pattern is read back intact by verify().
+// The transport is left at that rate, or at its old rate if none passed
+// (or if it has no rate control or no way to verify).
+// Note: the test pattern is sent to the strip too.
+uint32_t LPD8806VDTransport::calibrate(uint32_t minHz, uint32_t maxHz)
+{
+  uint8_t  pattern[32];
+  uint32_t old = getClock();
+  uint32_t best = 0;
+  uint32_t hz, rate;
+  size_t   sent = 0;                  // Test bytes sent, for the latch
+  uint8_t  i;
+
+  for (i = 0; i < sizeof(pattern); i++)
+    pattern[i] = 0x80 | (i * 37);      // High bit set, the rest varied
+
+  for (hz = minHz; hz != 0 && hz <= maxHz; hz *= 2)
+  {
+    rate = setClock(hz);
+    if (rate == 0)
+      break;
+    sent += sizeof(pattern);
+    if (!verify(pattern, sizeof(pattern)))
+      break;
+    best = hz;
+    if (hz > maxHz / 2)
+      break;
+  }
+
+  rate = setClock(best ? best : old);
+  writeZeros((sent / 3 + 31) / 32);    // Latch every pixel the patterns reached
+  return best ? rate : 0;
+}
+
+
+#if !defined(LPD8806VD_HOST)
+
+/*****************************************************************************/
+
+LPD8806VDSPI::LPD8806VDSPI()
+{
+  clock  = 0;
+  actual = 0;
+}
+
+
+// Enable SPI hardware and set up protocol details.
+void LPD8806VDSPI::begin(void)
+{
+  SPI.begin();
+  SPI.setBitOrder(MSBFIRST);
+  SPI.setDataMode(SPI_MODE0);
+  applyClock();
+}
+
+
+// Set the bit rate (rounded down to what the hardware can do).
+// Returns the rate set, or 0 if unknown.
+uint32_t LPD8806VDSPI::setClock(uint32_t hz)
+{
+  clock = hz;
+  applyClock();
+  return actual;
+}
+
+
+void LPD8806VDSPI::applyClock(void)
+{
+  if (clock == 0)
+  {
+    // Go as fast as you can go!!! :)
+    // 16MHz / 2 = 8 MHz -- go like sn*t!
+
+    SPI.setClockDivider(SPI_CLOCK_DIV4);
+    actual = 0;
+
+    // Although the LPD8806 should, in theory, work up to 20MHz, the unshielded
+    // wiring from the microcontroller can be more susceptible to interference.
+    // Experiment and see what you get.
+    return;
+  }
+
+#if defined(__AVR__)
+  // F_CPU / 2, 4, ... 128: take the first divider at or below the rate.
+  static const uint8_t dividers[7] =
+  {
+    SPI_CLOCK_DIV2, SPI_CLOCK_DIV4, SPI_CLOCK_DIV8, SPI_CLOCK_DIV16,
+    SPI_CLOCK_DIV32, SPI_CLOCK_DIV64, SPI_CLOCK_DIV128
+  };
+  uint8_t i;
+
+  for (i = 0; i < 6 && (F_CPU >> (i + 1)) > clock; i++);
+  SPI.setClockDivider(dividers[i]);
+  actual = F_CPU >> (i + 1);
+#elif defined(SPI_HAS_TRANSACTION)
+  // The core picks its best divider for the rate; it stays set after
+  // the transaction.
+  SPI.beginTransaction(SPISettings(clock, MSBFIRST, SPI_MODE0));
+  SPI.endTransaction();
+  actual = clock;
+#else
+  SPI.setClockDivider(SPI_CLOCK_DIV4);
+  actual = 0;
+#endif
+}
+
+
+void LPD8806VDSPI::end(void)
+{
+  SPI.end();
+}
+
+
+// Send a run of bytes.
+void LPD8806VDSPI::write(const uint8_t *data, size_t len)
+{
+#if defined(SPI_HAS_TRANSACTION)
+  // Newer SPI libraries can transfer a whole buffer (which lets some
+  // cores use a FIFO or DMA), but overwrite it with the bytes read back.
+  uint8_t buf[32];
+  size_t  count;
+
+  while (len)
+  {
+    count = (len > sizeof(buf)) ? sizeof(buf) : len;
+    memcpy(buf, data, count);
+    SPI.transfer(buf, count);
+    data += count;
+    len  -= count;
+  }
+#else
+  while (len--)
+    SPI.transfer(*data++);
+#endif
+}
+
+
+// Send "latch" clear bytes (0).
+void LPD8806VDSPI::writeZeros(size_t len)
+{
+  while (len--)
+    SPI.transfer(0);
+}
+
+
+// Send a run of bytes, checking each one comes back on MISO.
+boolean LPD8806VDSPI::verify(const uint8_t *data, size_t len)
+{
+  boolean ok = true;
+
+  while (len--)
+  {
+    if (SPI.transfer(*data) != *data)
+      ok = false;
+    data++;
+  }
+
+  return ok;
+}
+
+
+/*****************************************************************************/
+
+#if defined(LPD8806VD_AVR_SPI)
+
+// Send a run of bytes.
+void LPD8806VDAvrSPI::write(const uint8_t *data, size_t len)
+{
+  uint8_t next;
+
+  if (len == 0) return;
+  SPDR = *data++;                  // Issue first byte
+  while (--len)
+  {
+    next = *data++;                // Fetch next byte while this one is out
+    while (!(SPSR & (1 << SPIF))); // Wait for prior byte out
+    SPDR = next;                   // Issue new byte
+  }
+  while (!(SPSR & (1 << SPIF)));   // Wait for last byte out
+}
+
+
+// Send "latch" clear bytes (0).
+void LPD8806VDAvrSPI::writeZeros(size_t len)
+{
+  while (len--)
+  {
+    SPDR = 0;                      // send "latch" clear bytes (0)
+    while (!(SPSR & (1 << SPIF))); // Wait for prior byte out
+  }
+}
+
+#endif
+
+
+/*****************************************************************************/
+
+LPD8806VDBitbang::LPD8806VDBitbang(uint8_t dpin, uint8_t cpin)
+{
+  setPins(dpin, cpin);
+}
+
+
+// Change pins.  Takes effect at the next begin().
+void LPD8806VDBitbang::setPins(uint8_t dpin, uint8_t cpin)
+{
+  datapin     = dpin;
+  clkpin      = cpin;
+
+#if defined(LPD8806VD_FAST_PINS)
+  clkport     = LPD8806VD_PORT(cpin);
+  clkpinmask  = LPD8806VD_MASK(cpin);
+  dataport    = LPD8806VD_PORT(dpin);
+  datapinmask = LPD8806VD_MASK(dpin);
+#endif
+}
+
+
+// Enable software SPI pins.
+void LPD8806VDBitbang::begin(void)
+{
+  pinMode(datapin, OUTPUT);
+  pinMode(clkpin , OUTPUT);
+  digitalWrite(clkpin, LOW);
+}
+
+
+// Send a run of bytes via bit bang.
+// MSBFIRST implied; data changes while the clock is low, and is latched
+// by the strip on the rising edge.
+// With port registers, the port values for data high/low and clock
+// high/low are worked out once per write, then each bit is a plain store
+// (8 bits unrolled).  Other pins on the same port(s) keep the state
+// they had at the start of the write, so don't change them from an
+// interrupt while a show is running.
+void LPD8806VDBitbang::write(const uint8_t *data, size_t len)
+{
+#if defined(LPD8806VD_FAST_PINS)
+  LPD8806VDPortReg *port = dataport;
+  LPD8806VDPortMask lo, hi, clo, chi;
+  uint8_t b;
+
+  if (port == 0)
+  {
+    writeSlow(data, len);
+    return;
+  }
+
+  if (clkport == dataport)
+  {
+    // Clock and data on the same port: data and clock go out in one
+    // store; the clock falls with the next bit's data.
+    lo  = *port & ~(datapinmask | clkpinmask);
+    hi  = lo | datapinmask;
+    clo = lo | clkpinmask;
+    chi = hi | clkpinmask;
+
+#define LPD8806VD_BIT(m) \
+    if (b & (m)) { *port = hi; *port = chi; } else { *port = lo; *port = clo; }
+
+    while (len--)
+    {
+      b = *data++;
+      LPD8806VD_BIT(0x80) LPD8806VD_BIT(0x40) LPD8806VD_BIT(0x20) LPD8806VD_BIT(0x10)
+      LPD8806VD_BIT(0x08) LPD8806VD_BIT(0x04) LPD8806VD_BIT(0x02) LPD8806VD_BIT(0x01)
+    }
+    *port = lo;
+
+#undef LPD8806VD_BIT
+  }
+  else
+  {
+    LPD8806VDPortReg *cport = clkport;
+
+    lo  = *port & ~datapinmask;
+    hi  = lo | datapinmask;
+    clo = *cport & ~clkpinmask;
+    chi = clo | clkpinmask;
+
+#define LPD8806VD_BIT(m) \
+    *port = (b & (m)) ? hi : lo; *cport = chi; *cport = clo;
+
+    while (len--)
+    {
+      b = *data++;
+      LPD8806VD_BIT(0x80) LPD8806VD_BIT(0x40) LPD8806VD_BIT(0x20) LPD8806VD_BIT(0x10)
+      LPD8806VD_BIT(0x08) LPD8806VD_BIT(0x04) LPD8806VD_BIT(0x02) LPD8806VD_BIT(0x01)
+    }
+
+#undef LPD8806VD_BIT
+  }
+#else
+  writeSlow(data, len);
+#endif
+}
+
+
+// can't do low level bitbanging, revert to digitalWrite
+void LPD8806VDBitbang::writeSlow(const uint8_t *data, size_t len)
+{
+  uint8_t bit;
+
+  while (len--)
+  {
+    for (bit = 0x80; bit; bit >>= 1)
+    {
+      digitalWrite(datapin, (*data & bit) ? HIGH : LOW);
+      digitalWrite(clkpin, HIGH);
+      digitalWrite(clkpin, LOW);
+    }
+    data++;
+  }
+}
+
+#endif // !LPD8806VD_HOST
+
+
+/*****************************************************************************/
+
+LPD8806VDCapture::LPD8806VDCapture(uint8_t *buf, size_t size)
+{
+  buffer     = buf;
+  this->size = size;
+  count      = 0;
+#if defined(LPD8806VD_HOST)
+  file       = NULL;
+#endif
+}
+
+
+#if defined(LPD8806VD_HOST)
+LPD8806VDCapture::LPD8806VDCapture(FILE *f)
+{
+  buffer = NULL;
+  size   = 0;
+  count  = 0;
+  file   = f;
+}
+#endif
+
+
+// Record a run of bytes.
+void LPD8806VDCapture::write(const uint8_t *data, size_t len)
+{
+  size_t room;
+
+#if defined(LPD8806VD_HOST)
+  if (file != NULL)
+    fwrite(data, 1, len, file);
+#endif
+
+  if (buffer != NULL && count < size)
+  {
+    room = size - count;
+    memcpy(buffer + count, data, (len < room) ? len : room);
+  }
+
+  count += len;
+}
+
+
+// Record "latch" clear bytes (0).
+void LPD8806VDCapture::writeZeros(size_t len)
+{
+  size_t room;
+
+#if defined(LPD8806VD_HOST)
+  if (file != NULL)
+  {
+    LPD8806VDTransport::writeZeros(len);
+    return;
+  }
+#endif
+
+  if (buffer != NULL && count < size)
+  {
+    room = size - count;
+    memset(buffer + count, 0, (len < room) ? len : room);
+  }
+
+  count += len;
+}
+
+
+#if defined(LPD8806VD_HOST)
+// End of frame: push file output through (pipes).
+void LPD8806VDCapture::flush(void)
+{
+  if (file != NULL)
+    fflush(file);
+}
+#endif
+
+
+/*****************************************************************************/
+
+#if defined(LPD8806VD_HOST) && defined(__linux__)
+
+LPD8806VDSpidev::LPD8806VDSpidev(const char *path, uint8_t *buf, size_t size, uint32_t hz)
+{
+  this->path  = path;
+  buffer      = buf;
+  this->size  = size;
+  count       = 0;
+  clock       = hz;
+  maxTransfer = 4096;
+  fd          = -1;
+  spi         = false;
+}
+
+
+// Open the device (or file) and set up SPI mode 0, 8 bits, and the rate.
+void LPD8806VDSpidev::begin(void)
+{
+  uint8_t mode = SPI_MODE_0;
+  uint8_t bits = 8;
+  FILE *f;
+  unsigned long n;
+
+  end();
+
+  // Files are created/truncated; devices (a missing spidev) are not.
+  if (strncmp(path, "/dev/", 5) == 0)
+    fd = open(path, O_WRONLY | O_CLOEXEC);
+  else
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+    return;
+
+  // Not a spidev device: just write() to it.
+  spi = ioctl(fd, SPI_IOC_WR_MODE, &mode) == 0;
+  if (!spi)
+    return;
+
+  ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits);
+  setClock(clock);
+
+  f = fopen("/sys/module/spidev/parameters/bufsiz", "r");
+  if (f != NULL)
+  {
+    if (fscanf(f, "%lu", &n) == 1 && n > 0)
+      maxTransfer = n;
+    fclose(f);
+  }
+}
+
+
+void LPD8806VDSpidev::end(void)
+{
+  if (fd >= 0)
+  {
+    flush();
+    close(fd);
+  }
+
+  fd    = -1;
+  spi   = false;
+  count = 0;
+}
+
+
+uint32_t LPD8806VDSpidev::setClock(uint32_t hz)
+{
+  clock = hz;
+  if (spi)
+    ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &clock);
+
+  return clock;
+}
+
+
+// Hold bytes until the end of the frame (or until the buffer is full).
+void LPD8806VDSpidev::write(const uint8_t *data, size_t len)
+{
+  if (count + len > size)
+  {
+    flush();
+    if (len > size)
+    {
+      send(data, len);
+      return;
+    }
+  }
+
+  memcpy(buffer + count, data, len);
+  count += len;
+}
+
+
+void LPD8806VDSpidev::flush(void)
+{
+  if (count)
+    send(buffer, count);
+  count = 0;
+}
+
+
+// Send bytes to the device: one ioctl() per transfer, or write() to a file.
+void LPD8806VDSpidev::send(const uint8_t *data, size_t len)
+{
+  struct spi_ioc_transfer xfer;
+  size_t  n;
+  ssize_t done;
+
+  if (fd < 0)
+    return;
+
+  while (len)
+  {
+    if (spi)
+    {
+      n = (len > maxTransfer) ? maxTransfer : len;
+      memset(&xfer, 0, sizeof(xfer));
+      xfer.tx_buf        = (unsigned long)data;
+      xfer.len           = n;
+      xfer.speed_hz      = clock;
+      xfer.bits_per_word = 8;
+      done = ioctl(fd, SPI_IOC_MESSAGE(1), &xfer);
+    }
+    else
+      done = ::write(fd, data, len);
+
+    if (done <= 0)
+    {
+      if (done < 0 && errno == EINTR)
+        continue;
+      return;                          // Device gone: drop the frame
+    }
+
+    data += done;
+    len  -= done;
+  }
+}
+
+#endif
@@ -0,0 +1,234 @@
+/*
+||
+|| @author         Brett Hagman <bhagman@roguerobotics.com>
+|| @url            http://roguerobotics.com/
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Byte transports for LPD8806VD strips.
+|| | A transport gets the byte stream out to the strip:
+|| |   begin()                 - set up pins/hardware
+|| |   end()                   - release hardware
+|| |   write(data, len)        - send a run of bytes
+|| |   writeZeros(len)         - send a run of "latch" zeros
+|| |   flush()                 - end of frame: send anything held back
+|| |   setClock(hz)/verify()   - bit rate control, read back (optional)
+|| |
+|| | Backends:
+|| |   LPD8806VDAvrSPI         - AVR SPI registers (supported AVRs only)
+|| |   LPD8806VDSPI            - SPI library, SPI.transfer()
+|| |   LPD8806VDBitbang        - bit-bang'd SPI on any two pins
+|| |   LPD8806VDCapture        - records the byte stream to memory (or a
+|| |                             file, on a host build)
+|| |   LPD8806VDSpidev         - Linux spidev (or a file/pipe), host builds
+|| |
+|| | LPD8806VDHardwareSPI is the best hardware SPI backend for the target.
+|| |
+|| | Outside of Wiring/Arduino (no WIRING or ARDUINO defined), this is a
+|| | host build (LPD8806VD_HOST): only LPD8806VDCapture is available
+|| | (plus LPD8806VDSpidev on Linux), which is enough to run the encoding
+|| | side on a PC, or drive a strip from a single board computer.
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#ifndef LPD8806VDTRANSPORT_H
+#define LPD8806VDTRANSPORT_H
+
+// Meh... Dunno if it works with Arduino, but hey, we'll put this in here.
+#if defined(WIRING)
+ #include <Wiring.h>
+#elif defined(ARDUINO) && ARDUINO >= 100
+ #include <Arduino.h>
+#elif defined(ARDUINO)
+ #include <WProgram.h>
+#else
+ #define LPD8806VD_HOST
+ #include <stdint.h>
+ #include <stddef.h>
+ #include <string.h>
+ #include <stdio.h>
+ typedef bool boolean;
+#endif
+
+// Port registers for fast bit-bang: where the core can map a pin to its
+// output register and bitmask, pins are driven through the register.
+// AVR ports are 8 bits; ARM (SAM, SAMD, Teensy 3, ...) and ESP ports 32.
+#if defined(__AVR__)
+ #define LPD8806VD_FAST_PINS
+ typedef volatile uint8_t LPD8806VDPortReg;
+ typedef uint8_t LPD8806VDPortMask;
+#elif !defined(LPD8806VD_HOST) && defined(portOutputRegister) && defined(digitalPinToPort) && defined(digitalPinToBitMask)
+ #define LPD8806VD_FAST_PINS
+ typedef volatile uint32_t LPD8806VDPortReg;
+ typedef uint32_t LPD8806VDPortMask;
+#endif
+
+#if defined(LPD8806VD_FAST_PINS)
+ #define LPD8806VD_PORT(pin) ((LPD8806VDPortReg *)portOutputRegister(digitalPinToPort(pin)))
+ #define LPD8806VD_MASK(pin) ((LPD8806VDPortMask)digitalPinToBitMask(pin))
+#endif
+
+// AVRs where we can drive the SPI registers directly.
+#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__) || defined (__AVR_ATmega328__) || defined(__AVR_ATmega8__) || defined(__AVR_ATmega1281__) || defined(__AVR_ATmega2561__) || defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
+ #define LPD8806VD_AVR_SPI
+#endif
+
+
+class LPD8806VDTransport
+{
+  public:
+    virtual void begin(void) {};
+    virtual void end(void) {};
+    virtual void write(const uint8_t *data, size_t len) = 0;
+    virtual void writeZeros(size_t len);
+    virtual void flush(void) {};
+
+    // Bit rate control, where the transport has it.
+    virtual uint32_t setClock(uint32_t) { return 0; };  // Returns the rate set, in Hz (0 = fixed)
+    virtual uint32_t getClock(void) { return 0; };
+    virtual boolean verify(const uint8_t *, size_t) { return false; };  // Send, 'true' if read back intact
+    uint32_t calibrate(uint32_t minHz, uint32_t maxHz);  // Fastest rate that verifies (0 = none)
+};
+
+
+#if !defined(LPD8806VD_HOST)
+
+// Hardware SPI using the SPI library; specific pins only.
+// Loopback for verify(): jumper MISO to MOSI.
+class LPD8806VDSPI : public LPD8806VDTransport
+{
+  public:
+    LPD8806VDSPI();
+
+    void begin(void);
+    void end(void);
+    void write(const uint8_t *data, size_t len);
+    void writeZeros(size_t len);
+
+    uint32_t setClock(uint32_t hz);               // 0 = default (SPI_CLOCK_DIV4)
+    uint32_t getClock(void) { return clock; };
+    boolean verify(const uint8_t *data, size_t len);
+
+  private:
+    uint32_t clock;                               // Requested rate, Hz
+    uint32_t actual;                              // Rate set, Hz (0 = unknown)
+
+    void applyClock(void);
+};
+
+
+#if defined(LPD8806VD_AVR_SPI)
+
+// Hardware SPI, talking to the AVR SPI registers directly.
+// (The SPI library is still used to set things up.)
+class LPD8806VDAvrSPI : public LPD8806VDSPI
+{
+  public:
+    void write(const uint8_t *data, size_t len);
+    void writeZeros(size_t len);
+};
+
+typedef LPD8806VDAvrSPI LPD8806VDHardwareSPI;
+#else
+typedef LPD8806VDSPI LPD8806VDHardwareSPI;
+#endif
+
+
+// Bit-bang'd SPI; configurable pins.
+class LPD8806VDBitbang : public LPD8806VDTransport
+{
+  public:
+    LPD8806VDBitbang(uint8_t dpin = 0, uint8_t cpin = 0);
+
+    void setPins(uint8_t dpin, uint8_t cpin);
+    void begin(void);
+    void write(const uint8_t *data, size_t len);
+
+  private:
+    uint8_t clkpin, datapin;                      // Clock & data pin numbers
+#if defined(LPD8806VD_FAST_PINS)
+    LPD8806VDPortMask clkpinmask, datapinmask;    // Clock & data PORT bitmasks
+    LPD8806VDPortReg *clkport, *dataport;         // Clock & data PORT registers
+#endif
+
+    void writeSlow(const uint8_t *data, size_t len);
+};
+
+#endif // !LPD8806VD_HOST
+
+
+// Records the byte stream instead of sending it.
+// Bytes past the end of the buffer are counted, but not stored.
+// With a NULL buffer, only counts bytes.
+class LPD8806VDCapture : public LPD8806VDTransport
+{
+  public:
+    LPD8806VDCapture(uint8_t *buf, size_t size);   // Capture to memory
+#if defined(LPD8806VD_HOST)
+    LPD8806VDCapture(FILE *f);                    // Capture to a file/pipe
+#endif
+
+    void write(const uint8_t *data, size_t len);
+    void writeZeros(size_t len);
+#if defined(LPD8806VD_HOST)
+    void flush(void);
+#endif
+
+    size_t length(void) { return count; };        // Bytes sent since reset()
+    void reset(void) { count = 0; };              // Start capturing from the top
+
+  private:
+    uint8_t *buffer;
+    size_t size;
+    size_t count;
+#if defined(LPD8806VD_HOST)
+    FILE *file;
+#endif
+};
+
+
+#if defined(LPD8806VD_HOST) && defined(__linux__)
+
+// Linux userspace SPI (/dev/spidevX.Y), for single board computers.
+// Bytes are gathered in buf (LPD8806VD_WIRE_SIZE(numPixels()) bytes
+// holds a whole frame) and sent with one ioctl() at the end of the frame.
+// Without a buffer, every run of bytes is sent as it comes.
+// Any other path (a file, a FIFO, /dev/stdout) is written to instead,
+// one write() per frame, e.g. to record or pipe the stream.
+// Note: spidev limits a transfer to its bufsiz module parameter (4096
+// bytes by default); longer frames go out in that many ioctl()s.  Raise
+// it (e.g. spidev.bufsiz=65536 on the kernel command line) for one.
+class LPD8806VDSpidev : public LPD8806VDTransport
+{
+  public:
+    LPD8806VDSpidev(const char *path, uint8_t *buf = NULL, size_t size = 0, uint32_t hz = 8000000UL);
+
+    void begin(void);
+    void end(void);
+    void write(const uint8_t *data, size_t len);
+    void flush(void);
+
+    uint32_t setClock(uint32_t hz);
+    uint32_t getClock(void) { return clock; };
+    boolean isOpen(void) { return fd >= 0; };
+    boolean isSpi(void) { return spi; };          // 'false' if writing a plain file/pipe
+
+  private:
+    const char *path;
+    uint8_t *buffer;
+    size_t size;
+    size_t count;                                 // Bytes held in buffer
+    uint32_t clock;                               // Bit rate, Hz
+    size_t maxTransfer;                           // Largest spidev transfer
+    int fd;
+    boolean spi;
+
+    void send(const uint8_t *data, size_t len);
+};
+
+#endif
+
+#endif
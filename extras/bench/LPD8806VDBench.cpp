@@ -0,0 +1,365 @@
+/*
+||
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Host benchmark for the LPD8806VD encode and transmit paths.
+|| | Runs setPixelColor(), Color(), getPixelColor(), clear(), the bulk
+|| | fill/setPixels/rotate calls, fadeAll/crossfade and show() (into a
+|| | LPD8806VDCapture; also with LPD8806VDParallel) for every color depth
+|| | and strip lengths from 32 to 4096 pixels, and reports ns/pixel and
+|| | bytes/s.  Before that, the bulk (SIMD) encoder is checked byte for
+|| | byte against the one pixel at a time encoder, and strips past the old
+|| | 16 bit limits (up to 100000 pixels) have every byte they send
+|| | checked, including fill(), copyRange() and showDirty() across the
+|| | 16 bit boundary.
+|| |
+|| | Build and run (from the library folder):
+|| |   g++ -O2 -std=c++11 -pthread -I. extras/bench/LPD8806VDBench.cpp \
+|| |       LPD8806VD.cpp LPD8806VDTransport.cpp LPD8806VDCodec.cpp \
+|| |       LPD8806VDParallel.cpp -o lpd8806vd_bench
+|| |   (add -DLPD8806VD_USE_LUT to time the lookup table encoder, and
+|| |   -mssse3 or -march=native for the SSSE3 8 and 16 bit encoders)
+|| |   ./lpd8806vd_bench
+|| |
+|| | Numbers are for the host CPU, so use them to compare changes, not to
+|| | predict timings on a microcontroller.
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "LPD8806VD.h"
+#include "LPD8806VDParallel.h"
+
+// Minimum time spent on each measurement.
+#define BENCH_MIN_NS 20000000.0
+
+static volatile uint32_t sink;
+
+
+struct Result
+{
+  double nsPerPixel;
+  double bytesPerSec;
+};
+
+
+// Run op() repeatedly for at least BENCH_MIN_NS, return ns per call.
+template<class Op> static double timeOp(Op op)
+{
+  typedef std::chrono::steady_clock Clock;
+  unsigned long iterations = 1;
+  double ns;
+
+  op();  // warm up
+
+  for (;;)
+  {
+    Clock::time_point start = Clock::now();
+    for (unsigned long i = 0; i < iterations; i++)
+      op();
+    ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    if (ns >= BENCH_MIN_NS)
+      return ns / iterations;
+    iterations *= 2;
+  }
+}
+
+
+static void report(const char *name, uint8_t depth, LPD8806VDIndex n, double nsPerCall, size_t bytesPerCall)
+{
+  printf("%-16s %5u %6lu %10.2f", name, depth * 8, (unsigned long)n, nsPerCall / n);
+  if (bytesPerCall)
+    printf(" %12.1f", bytesPerCall / (nsPerCall * 1e-9) / 1e6);
+  printf("\n");
+}
+
+
+static void bench(uint8_t depth, LPD8806VDIndex n)
+{
+  std::vector<uint8_t> pixels(n * depth);
+  std::vector<uint8_t> wire(LPD8806VD_WIRE_SIZE(n));
+  std::vector<uint8_t> out(LPD8806VD_WIRE_SIZE(n));
+  std::vector<uint32_t> colors(n);
+  LPD8806VDCapture capture(out.data(), out.size());
+  LPD8806VD strip(n, &capture, pixels.data(), depth);
+  LPD8806VDIndex i;
+
+  strip.begin();
+
+  srand(n);
+  for (i = 0; i < n; i++)
+    colors[i] = strip.Color(rand(), rand(), rand());
+
+  report("Color", depth, n, timeOp([&] {
+    uint32_t acc = 0;
+    for (LPD8806VDIndex j = 0; j < n; j++)
+      acc += strip.Color(j, j >> 1, ~j);
+    sink = acc;
+  }), 0);
+
+  report("setPixelColor", depth, n, timeOp([&] {
+    for (LPD8806VDIndex j = 0; j < n; j++)
+      strip.setPixelColor(j, colors[j]);
+  }), 0);
+
+  report("getPixelColor", depth, n, timeOp([&] {
+    uint32_t acc = 0;
+    for (LPD8806VDIndex j = 0; j < n; j++)
+      acc += strip.getPixelColor(j);
+    sink = acc;
+  }), 0);
+
+  report("clear", depth, n, timeOp([&] {
+    strip.clear();
+  }), n * depth);
+
+  report("fill", depth, n, timeOp([&] {
+    strip.fill(colors[0]);
+  }), n * depth);
+
+  report("setPixels", depth, n, timeOp([&] {
+    strip.setPixels(0, colors.data(), n);
+  }), 0);
+
+  report("rotate(1)", depth, n, timeOp([&] {
+    strip.rotate(1);
+  }), n * depth);
+
+  std::vector<uint8_t> frameA(pixels), frameB(n * depth);
+  for (i = 0; i < n * depth; i++)
+    frameB[i] = rand() & 0x7f;
+
+  report("fadeAll", depth, n, timeOp([&] {
+    strip.fadeAll(250);
+  }), n * depth);
+
+  report("crossfade", depth, n, timeOp([&] {
+    strip.crossfade(frameA.data(), frameB.data(), 100);
+  }), n * depth);
+
+  for (i = 0; i < n; i++)
+    strip.setPixelColor(i, colors[i]);
+
+  report("show", depth, n, timeOp([&] {
+    capture.reset();
+    strip.show();
+  }), LPD8806VD_WIRE_SIZE(n));
+
+  {
+    LPD8806VDParallel parallel(strip);
+
+    report("show (parallel)", depth, n, timeOp([&] {
+      capture.reset();
+      parallel.show();
+    }), LPD8806VD_WIRE_SIZE(n));
+  }
+
+  // Same again, with a wire-ready buffer
+  strip.setWireBuffer(wire.data());
+
+  report("setPixel (wire)", depth, n, timeOp([&] {
+    for (LPD8806VDIndex j = 0; j < n; j++)
+      strip.setPixelColor(j, colors[j]);
+  }), 0);
+
+  report("show (wire)", depth, n, timeOp([&] {
+    capture.reset();
+    strip.show();
+  }), LPD8806VD_WIRE_SIZE(n));
+}
+
+
+// Wire bytes for packed color c at the given depth.
+static void encodeColor(uint8_t depth, uint32_t c, uint8_t *out)
+{
+  uint8_t p[3];
+
+  switch (depth)
+  {
+    case 1:
+      LPD8806VDCodec<1>::store(p, c);
+      LPD8806VDCodec<1>::encode(p, out);
+      break;
+    case 2:
+      LPD8806VDCodec<2>::store(p, c);
+      LPD8806VDCodec<2>::encode(p, out);
+      break;
+    case 3:
+      LPD8806VDCodec<3>::store(p, c);
+      LPD8806VDCodec<3>::encode(p, out);
+      break;
+  }
+}
+
+
+// The captured stream against the model: count pixels, then their latch.
+// Returns the first byte offset that is wrong, or -1.
+static long compareSent(LPD8806VDCapture &capture, const std::vector<uint8_t> &sent,
+                        const std::vector<uint32_t> &model, uint8_t depth, LPD8806VDIndex count)
+{
+  uint8_t out[3];
+  size_t  i, k;
+
+  if (capture.length() != LPD8806VD_WIRE_SIZE((size_t)count))
+    return (long)capture.length();
+
+  for (i = 0; i < count; i++)
+  {
+    encodeColor(depth, model[i], out);
+    for (k = 0; k < 3; k++)
+      if (sent[i * 3 + k] != out[k])
+        return (long)(i * 3 + k);
+  }
+
+  for (i = (size_t)count * 3; i < capture.length(); i++)
+    if (sent[i] != 0)
+      return (long)i;
+
+  return -1;
+}
+
+
+// Every byte sent for a long strip, with and without a wire buffer:
+// a pattern that differs for pixels 65536 apart, then (past 65536
+// pixels) fill(), copyRange() and showDirty() across the 16 bit
+// boundary.  A 16 bit index or a truncated offset anywhere on the way
+// shows up as a wrong byte.
+static bool checkLarge(uint8_t depth, LPD8806VDIndex n, bool useWire)
+{
+  const LPD8806VDIndex b = 65536;               // First pixel past 16 bits
+  std::vector<uint8_t> pixels(n * depth), wire(LPD8806VD_WIRE_SIZE((size_t)n));
+  std::vector<uint8_t> sent(LPD8806VD_WIRE_SIZE((size_t)n) + 1);
+  std::vector<uint32_t> model(n);
+  LPD8806VDCapture capture(sent.data(), sent.size());
+  LPD8806VD strip(n, &capture, pixels.data(), depth);
+  LPD8806VDIndex i;
+  const char *what = "pattern";
+  long bad;
+
+  if (useWire)
+    strip.setWireBuffer(wire.data());
+  strip.begin();
+
+  for (i = 0; i < n; i++)
+  {
+    model[i] = strip.Color(i, i >> 8, (i >> 16) * 97 + 11);
+    strip.setPixelColor(i, model[i]);
+  }
+  capture.reset();
+  strip.show();
+  bad = compareSent(capture, sent, model, depth, n);
+
+  if (bad < 0 && n > b + 32)
+  {
+    what = "fill";
+    strip.fill(strip.Color(255, 128, 0), b - 6, 12);
+    strip.fill(strip.Color(0, 128, 255), b + 100, 12);
+    for (i = 0; i < 12; i++)
+    {
+      model[b - 6 + i]   = strip.Color(255, 128, 0);
+      model[b + 100 + i] = strip.Color(0, 128, 255);
+    }
+    capture.reset();
+    strip.show();
+    bad = compareSent(capture, sent, model, depth, n);
+  }
+
+  if (bad < 0 && n > b + 32)
+  {
+    what = "copyRange";
+    strip.copyRange(b - 10, 3, 20);             // Onto the boundary,
+    strip.copyRange(b + 200, b - 300, 20);      // past it,
+    strip.copyRange(40, b + 60, 20);            // and back from past it
+    for (i = 0; i < 20; i++)
+    {
+      model[b - 10 + i]  = model[3 + i];
+      model[b + 200 + i] = model[b - 300 + i];
+      model[40 + i]      = model[b + 60 + i];
+    }
+    capture.reset();
+    strip.show();
+    bad = compareSent(capture, sent, model, depth, n);
+  }
+
+  if (bad < 0 && n > b + 32)
+  {
+    what = "showDirty";
+    model[b + 4] = strip.Color(0, 0, 255);
+    strip.setPixelColor(b + 4, model[b + 4]);
+    capture.reset();
+    strip.showDirty();
+    bad = compareSent(capture, sent, model, depth, b + 5);
+  }
+
+  if (bad < 0)
+    return true;
+
+  printf("large strip: %u bits, %lu pixels%s: %s sent a wrong byte at %ld (%lu bytes sent)\n",
+         depth * 8, (unsigned long)n, useWire ? " (wire)" : "", what, bad, (unsigned long)capture.length());
+  return false;
+}
+
+
+// Bulk (SIMD) encoder vs. the one pixel at a time encoder: every pixel
+// value for 8 and 16 bit color, random bytes for 24 bit, and every
+// length up to 48 pixels (the scalar tail), from an odd address.
+template<uint8_t Depth> static bool checkEncode(void)
+{
+  const size_t n = (Depth == 3) ? 4096 : ((size_t)1 << (8 * Depth));
+  std::vector<uint8_t> pixels(n * Depth + 1), bulk(n * 3), ref(n * 3);
+  size_t i, len;
+
+  for (i = 0; i < n; i++)
+    for (uint8_t k = 0; k < Depth; k++)
+      pixels[i * Depth + k + 1] = (Depth == 3) ? rand() : i >> (8 * (Depth - 1 - k));
+
+  for (i = 0; i < n; i++)
+    LPD8806VDCodec<Depth>::encode(&pixels[i * Depth + 1], &ref[i * 3]);
+
+  for (len = 0; len <= n; len += (len < 48) ? 1 : n - 48)  // 0..48, then n
+  {
+    memset(bulk.data(), 0, bulk.size());
+    LPD8806VDCodec<Depth>::encodeBulk(&pixels[1], bulk.data(), len);
+    if (memcmp(bulk.data(), ref.data(), len * 3) != 0)
+    {
+      printf("encodeBulk: %u bits, %lu pixels: mismatch\n", Depth * 8, (unsigned long)len);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+int main(void)
+{
+  static const unsigned long large[] = { 8160, 8161, 65535, 65536, 100000 };
+  uint8_t  depth;
+  LPD8806VDIndex n;
+  unsigned i;
+  bool ok = checkEncode<1>() && checkEncode<2>() && checkEncode<3>();
+
+  for (depth = 1; depth <= 3; depth++)
+    for (i = 0; i < sizeof(large) / sizeof(large[0]); i++)
+      if (sizeof(LPD8806VDIndex) > 2 || large[i] <= 65535)
+        ok &= checkLarge(depth, large[i], false) && checkLarge(depth, large[i], true);
+  if (!ok)
+    return 1;
+
+  printf("%-16s %5s %6s %10s %12s\n", "op", "bits", "pixels", "ns/pixel", "MB/s");
+
+  for (depth = 1; depth <= 3; depth++)
+    for (n = 32; n <= 4096; n *= 2)
+      bench(depth, n);
+
+  return 0;
+}
@@ -0,0 +1,61 @@
+/*
+||
+|| @url            https://github.com/bhagman/LPD8806VD
+||
+|| @description
+|| | Host side delta encoder: reads raw frames (packed pixels, as in the
+|| | strip's pixel buffer) from stdin and writes the delta stream for
+|| | LPD8806VDDeltaDecoder to stdout.  The first frame is sent whole.
+|| |
+|| | Build and run (from the library folder):
+|| |   g++ -O2 -I. extras/delta/LPD8806VDDeltaPipe.cpp \
+|| |       LPD8806VDDelta.cpp LPD8806VD.cpp LPD8806VDTransport.cpp \
+|| |       LPD8806VDCodec.cpp -o lpd8806vd_delta
+|| |   ./lpd8806vd_delta 160 2 < frames.raw > /dev/ttyUSB0
+|| |   (160 pixels, 2 bytes per pixel; set up the port with stty first)
+|| #
+||
+|| @license BSD License.
+||
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "LPD8806VDDelta.h"
+
+
+int main(int argc, char **argv)
+{
+  if (argc != 3)
+  {
+    fprintf(stderr, "usage: %s pixels depth < frames > stream\n", argv[0]);
+    return 1;
+  }
+
+  LPD8806VDIndex n = strtoul(argv[1], NULL, 0);
+  uint8_t depth = atoi(argv[2]);
+
+  if (n == 0 || depth < 1 || depth > 3)
+  {
+    fprintf(stderr, "pixels must be at least 1, depth 1-3\n");
+    return 1;
+  }
+
+  std::vector<uint8_t> prev(n * depth), cur(n * depth);
+  std::vector<uint8_t> out(LPD8806VD_DELTA_MAX(n, depth));
+  bool first = true;
+  size_t len;
+
+  while (fread(&cur[0], 1, cur.size(), stdin) == cur.size())
+  {
+    len = LPD8806VDDeltaEncode(first ? NULL : &prev[0], &cur[0], n, depth, &out[0]);
+    fwrite(&out[0], 1, len, stdout);
+    fflush(stdout);
+    prev.swap(cur);
+    first = false;
+  }
+
+  return 0;
+}